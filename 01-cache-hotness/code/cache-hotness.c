@@ -1,8 +1,10 @@
 #include <config.h>
 
+#include <math.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -10,12 +12,18 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <linux/futex.h>
 #include <linux/limits.h>
+#include <linux/perf_event.h>
 #include <sched.h>
+#include <signal.h>
 #include <string.h>
+#include <sys/epoll.h>
 #include <sys/mman.h>
+#include <sys/prctl.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/sysinfo.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -23,7 +31,93 @@
 #include <time.h>
 #include <unistd.h>
 
+#if !defined(__x86_64__)
+#include <ucontext.h>
+#endif
+
+#include "code-footprint.h"
+
 static int verbose = 2;
+static bool messages_to_stderr = false; // set when stdout carries the campaign lines
+
+enum antagonist_mode {
+    ANTAGONIST_LLC,         // touch lines in a scattered order to evict the shared cache
+    ANTAGONIST_BANDWIDTH,   // stream through memory to saturate the memory bus
+};
+
+enum prefault {
+    PREFAULT_NONE,      // leave the first touch page faults to the timed region
+    PREFAULT_TOUCH,     // write every cache line once before the timed region
+    PREFAULT_POPULATE,  // let mmap() populate the page tables with MAP_POPULATE
+    PREFAULT_MLOCK,     // lock current and future pages with mlockall()
+};
+
+enum syscall_kind {
+    SYSCALL_READ,       // small pread() from a tmpfs file
+    SYSCALL_WRITE,      // small write() to a pipe
+    SYSCALL_GETPID,
+    SYSCALL_FUTEX,      // FUTEX_WAKE without waiters
+    SYSCALL_EPOLL,      // epoll_wait() without timeout
+    SYSCALL_KIND_COUNT,
+};
+
+const char *syscall_names[SYSCALL_KIND_COUNT] = { "read", "write", "getpid", "futex", "epoll" };
+
+enum backing {
+    BACKING_ANON,
+    BACKING_SHM,            // memfd, one per task
+    BACKING_SHM_HUGETLB,    // memfd from the hugetlb pool
+    BACKING_FILE,           // regular or tmpfs file, every task maps its own range
+};
+
+// madvise() hints for the working set, the index is stored in the settings
+const char *madvise_names[] = { "none", "random", "sequential", "willneed", "hugepage", "nohugepage" };
+const int madvise_advice[] = { -1, MADV_RANDOM, MADV_SEQUENTIAL, MADV_WILLNEED, MADV_HUGEPAGE, MADV_NOHUGEPAGE };
+
+enum audit_mode {
+    AUDIT_OFF,
+    AUDIT_WARN,     // warn if the noise score is below the threshold
+    AUDIT_REFUSE,   // refuse to run if the noise score is below the threshold
+};
+
+#define AUDIT_GAP_NS 1000 // interruptions of the busy-loop longer than this count as noise
+
+struct audit {
+    char governor[32];
+    int turbo;              // 1 if enabled, 0 if disabled, -1 if unknown
+    bool isolated;
+    bool nohz_full;
+    long runnable;          // other runnable tasks on the whole system, not scored
+    size_t interrupts;      // on the measured CPU during the busy-loop
+    double interrupt_rate;  // per second
+    long duration_ns;
+    long max_gap_ns;
+    long noise_ns;          // sum of all gaps longer than AUDIT_GAP_NS
+    size_t gaps;
+    int score;              // 0 to 100, higher is quieter
+};
+
+#define FIT_MAX_POINTS 32
+#define CAMPAIGN_MAX_POINTS 64
+
+// Effective frequency is counted either by perf events for the cycles and reference cycles of the task itself, or by
+// the APERF and MPERF registers of the CPU, which need read access to /dev/cpu/N/msr.
+enum freq_source {
+    FREQ_NONE,
+    FREQ_PERF,
+    FREQ_MSR,
+};
+
+enum workload {
+    WORKLOAD_DATA,  // access the cache lines of the working set
+    WORKLOAD_CODE,  // call the generated functions, see gen-code-footprint.sh
+};
+
+enum warm {
+    WARM_NONE,
+    WARM_PREFETCH,  // issue a software prefetch for every line
+    WARM_TOUCH,     // read one word of every line
+};
 
 struct settings {
     size_t cache_line_size; // retrieved from sysfs
@@ -31,7 +125,44 @@ struct settings {
     size_t access_per_cache_line;
     size_t iterations_per_yield;
 
+    size_t reuse;               // percent of the lines of a slice that the previous slice touched too
+    size_t reuse_pool;          // the other lines rotate through a pool this many times their number
+
+    enum workload workload;
+    size_t code_footprint;      // per task, rounded to whole functions
+    size_t code_function_size;  // average size of a generated function
+    size_t icache_size;         // L1I size retrieved from sysfs, 0 if not available
+
     size_t yield_count;
+    enum prefault prefault;
+
+    enum backing backing;
+    char backing_path[PATH_MAX]; // only with BACKING_FILE
+    bool mapping_shared;        // MAP_SHARED instead of MAP_PRIVATE
+    size_t madvise_hint;        // index into madvise_names
+
+    int conflict_level;         // 0 when the working set is spread over all cache sets
+    size_t conflict_lines;      // lines per set, defaults to the associativity
+    size_t conflict_sets;       // retrieved from sysfs
+    size_t conflict_ways;       // retrieved from sysfs
+
+    size_t syscalls[SYSCALL_KIND_COUNT]; // syscalls of each kind at every yield point
+
+    size_t coroutine_count; // 0 runs the tasks as processes
+
+    enum warm warm;         // warm-up pass at the start of every slice
+    size_t warm_prefix;     // bytes of the working set to warm up, 0 for all of it
+
+    double until_stable;    // target relative error of the concurrency penalty, 0 runs once
+    double time_budget;     // in seconds, upper limit for the trials of until_stable
+
+    size_t fit_iterations[FIT_MAX_POINTS]; // iterations_per_yield of every run of the refill fit
+    size_t fit_points;      // 0 disables the refill fit
+
+    enum audit_mode audit_mode;
+    long audit_duration;    // in ms
+    int audit_threshold;
+    struct audit audit;
 
     char outfile[PATH_MAX];
 
@@ -41,6 +172,194 @@ struct settings {
     size_t cpu;
     ssize_t cpu_freq_start;
     ssize_t cpu_freq_finish;
+
+    enum freq_source freq_source;   // picked by configure
+    bool freq_slices;       // also measure the effective frequency of every slice
+    double freq_tolerance;  // relative variation of the effective frequency beyond which a run is not trusted
+
+    cpu_set_t antagonist_cpus;
+    enum antagonist_mode antagonist_mode;
+    size_t antagonist_footprint; // defaults to a multiple of the LLC size
+
+    size_t progress_interval; // in ms, 0 disables the progress reporter
+    char progress_file[PATH_MAX];
+
+    cpu_set_t campaign_cpus;    // empty unless running a campaign
+    size_t campaign_memory[CAMPAIGN_MAX_POINTS]; // memory_total of every point of the campaign
+    size_t campaign_points;
+    size_t campaign_reuse[CAMPAIGN_MAX_POINTS]; // reuse of every point, swept for each memory size
+    size_t campaign_reuse_count; // 0 keeps reuse
+    bool campaign_separate_llc;
+    int campaign_audit_scores[CPU_SETSIZE]; // audit score of every campaign CPU
+};
+
+#define TELEMETRY_RING_SIZE 256 // must be a power of two
+
+struct telemetry_entry {
+    size_t slice;
+    struct timespec time;
+};
+
+// Single-producer ring written by one measured task and read by the reporter. The producer only does plain stores,
+// so publishing costs the measured CPU no syscalls and no locked instructions.
+struct telemetry_ring {
+    size_t head __attribute__((aligned(128)));
+    struct telemetry_entry entries[TELEMETRY_RING_SIZE] __attribute__((aligned(128)));
+};
+
+struct memory {
+    size_t **blocks;        // one pointer per cache line in the working set, followed by the pool
+    size_t block_count;     // lines touched per pass
+    void *arena;
+    size_t arena_size;
+
+    size_t code_first;      // first generated function of the task in the code workload
+    size_t code_count;
+    size_t code_lines;      // cache lines of code executed per pass
+
+    size_t hot_count;       // lines touched in every slice, the rest of block_count is a window into the pool
+    size_t pool_count;      // 0 when every slice touches the same lines
+    size_t pool_position;   // start of the window of the next slice
+};
+
+struct telemetry {
+    struct telemetry_ring parent;
+    struct telemetry_ring child;
+    int finished;
+};
+
+// The processes that run next to the measured tasks. They are stopped on every way out of a measurement.
+struct helpers {
+    pid_t owner;            // the process that started them
+    int antagonist_count;   // started so far
+    pid_t antagonist_pids[CPU_SETSIZE];
+    volatile size_t *antagonist_passes;
+    struct timespec time_antagonists_start;
+    struct telemetry *telemetry;
+    pid_t reporter_pid;
+};
+
+struct rates {
+    double access_rate;     // accesses per second
+    double bandwidth;       // GB/s, 10^9 bytes per second
+    double ns_per_access;
+};
+
+struct freq_counter {
+    enum freq_source source;
+    int cycles_fd;          // perf group leader, or the msr device
+    int ref_cycles_fd;
+    bool user_only;         // the perf counters exclude the kernel
+    double ref_ghz;         // reference cycles per ns, only measured with user_only
+};
+
+struct freq_sample {
+    uint64_t cycles;        // cycles or APERF
+    uint64_t ref_cycles;    // reference cycles or MPERF
+    uint64_t time_ns;       // time the perf counters ran, or wall-clock time for the MSRs
+};
+
+// Effective frequency of a task over a phase.
+struct freq_phase {
+    double ghz;             // cycles per ns
+    double ratio;           // cycles per reference cycle, 1.0 at the nominal frequency
+};
+
+struct freq_results {
+    struct freq_phase middle;
+    struct freq_phase total;
+    double slice_ghz_min;   // only with freq_slices
+    double slice_ghz_max;
+    double slice_ratio_min;
+    double slice_ratio_max;
+    bool user_only;         // the frequency is derived from the ratio, see freq_counter
+};
+
+struct cache_info {
+    int level;
+    char type[16];
+    size_t size;
+    size_t line_size;
+    size_t sets;
+    size_t ways;
+};
+
+struct syscall_context {
+    int file_fd;
+    int pipefds[2];
+    int epoll_fd;
+    int futex_word;
+    bool pipe_full;     // a write found the pipe full, it is drained after the timed syscalls
+    char buf[512];
+};
+
+#define COROUTINE_STACK_SIZE (64 * 1024)
+#define COROUTINE_MAX_COUNT 256     // every coroutine maps its own working set and stack
+
+struct coroutine_context {
+#if defined(__x86_64__)
+    void *stack_pointer;
+#else
+    ucontext_t context;
+#endif
+};
+
+struct coroutine {
+    struct coroutine_context context;
+    void *stack;
+    struct memory *memory;
+    struct timespec time_middle;
+    struct timespec time;
+    bool finished;
+};
+
+struct coroutine_scheduler {
+    const struct settings *settings;
+    struct coroutine_context main_context;
+    struct coroutine *coroutines;
+    size_t count;
+    size_t current;
+    struct timespec time_start;
+    struct syscall_context *syscall_context;
+    long time_syscalls_ns;
+    long time_warm_ns;
+    long time_work_ns;
+};
+
+struct prefault_results {
+    struct timespec time;   // allocating and prefaulting the working set
+    size_t minflt;
+    size_t majflt;
+};
+
+#define STABILITY_MIN_TRIALS 3
+#define STABILITY_MAX_TRIALS 1000
+
+// The concurrency penalty is the average execution time of a concurrent run minus that of a sequential run.
+struct stability {
+    size_t trials;          // pairs of concurrent and sequential runs
+    size_t discarded;       // pairs dropped because the effective frequency varied beyond freq_tolerance
+    bool converged;
+    double penalty;         // mean over the trials, in seconds
+    double penalty_ci;      // half-width of the 95% confidence interval, in seconds
+    double relative_error;  // penalty_ci / penalty
+    double time_concurrent; // mean over the trials, in seconds
+    double time_sequential; // mean over the trials, in seconds
+    double elapsed;         // wall-clock time of all trials, in seconds
+};
+
+// Time per slice as a linear function of the iterations per slice. The slope is the steady-state cost of one pass
+// over the working set, the intercept what every slice pays on top of its passes. Without the cost of the switch
+// itself, measured by slices that do no passes at all, what remains is the cost of refilling the caches.
+struct refill_fit {
+    size_t points;
+    size_t iterations[FIT_MAX_POINTS];
+    double time_per_slice[FIT_MAX_POINTS]; // timed region over the slices of both tasks, in seconds
+    double switch_cost;     // time per slice without passes, in seconds
+    double intercept;       // in seconds
+    double refill_cost;     // intercept - switch_cost, in seconds
+    double pass_cost;       // slope, in seconds
+    double r_squared;
 };
 
 struct results {
@@ -63,6 +382,62 @@ struct results {
     size_t minflt_child_end;
     size_t majflt_child_start;
     size_t majflt_child_end;
+
+    struct prefault_results prefault_parent;
+    struct prefault_results prefault_child;
+    size_t minflt_timed_parent; // page faults between the start and the end of the timed region
+    size_t majflt_timed_parent;
+    size_t minflt_timed_child;
+    size_t majflt_timed_child;
+
+    struct timespec time_syscalls_parent; // spent in the injected syscalls, included in time_parent
+    struct timespec time_syscalls_child;
+    struct timespec time_warm_parent;   // spent in the warm-up passes, included in time_parent
+    struct timespec time_warm_child;
+    struct timespec time_work_parent;   // spent accessing memory after the warm-up passes
+    struct timespec time_work_child;
+
+    size_t accesses;        // memory accesses per task
+    size_t bytes;           // bytes touched per task, counted in whole cache lines
+    struct rates rates_parent;
+    struct rates rates_child;
+    struct rates rates_middle_parent;
+    struct rates rates_middle_child;
+
+    struct freq_results freq_parent;
+    struct freq_results freq_child;
+    double freq_variation;  // (highest - lowest) / lowest frequency ratio of all phases and slices
+    bool freq_stable;       // freq_variation is within freq_tolerance
+    double cycles_parent;   // execution times normalized to cycles at the effective frequency
+    double cycles_child;
+    double cycles_middle_parent;
+    double cycles_middle_child;
+
+    size_t antagonist_passes;   // passes over the footprint by all antagonists
+    double antagonist_bandwidth; // GB/s, sum of all antagonists
+
+    struct stability stability; // only with until_stable
+    struct refill_fit fit;      // only with fit_refill
+};
+
+struct coroutine_results {
+    size_t count;
+    struct timespec *time;          // per task
+    struct timespec *time_middle;   // per task
+    struct timespec time_average;
+    struct timespec time_syscalls;  // all tasks together
+    struct timespec time_warm;      // all tasks together
+    struct timespec time_work;      // all tasks together
+    struct prefault_results prefault; // all tasks together
+
+    size_t minflt_timed;
+    size_t majflt_timed;
+    size_t vcsw;
+    size_t ivcsw;
+
+    size_t accesses;
+    size_t bytes;
+    struct rates rates;             // for the average execution time
 };
 
 void print_msg(int level, const char *format, ...)
@@ -76,7 +451,7 @@ void print_msg(int level, const char *format, ...)
     }
     else if (level <= verbose)
     {
-        vprintf(format, args);
+        vfprintf(messages_to_stderr ? stderr : stdout, format, args);
     }
 }
 
@@ -136,6 +511,204 @@ ssize_t human_readable_size(size_t size, char *buf, size_t buf_size)
     return result;
 }
 
+int parse_cpu_list(const char *str, cpu_set_t *cpu_set)
+{
+    CPU_ZERO(cpu_set);
+
+    const char *ptr = str;
+    while (*ptr != '\0')
+    {
+        char *endptr;
+        long first = strtol(ptr, &endptr, 10);
+        if ((endptr == ptr) || (first < 0) || (first >= CPU_SETSIZE))
+        {
+            return -1;
+        }
+        long last = first;
+        ptr = endptr;
+        if (*ptr == '-')
+        {
+            ++ptr;
+            last = strtol(ptr, &endptr, 10);
+            if ((endptr == ptr) || (last < first) || (last >= CPU_SETSIZE))
+            {
+                return -1;
+            }
+            ptr = endptr;
+        }
+
+        for (long cpu = first; cpu <= last; ++cpu)
+        {
+            CPU_SET(cpu, cpu_set);
+        }
+
+        if (*ptr == ',')
+        {
+            ++ptr;
+        }
+        else if ((*ptr != '\0') && (*ptr != '\n'))
+        {
+            return -1;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+// Parses a comma separated list of numbers, returns the count or -1 on error.
+int parse_number_list(const char *str, size_t *values, size_t max_count)
+{
+    size_t count = 0;
+    const char *ptr = str;
+    while (*ptr != '\0')
+    {
+        char *endptr;
+        long value = strtol(ptr, &endptr, 10);
+        if ((endptr == ptr) || (value < 0) || (count == max_count))
+        {
+            return -1;
+        }
+        values[count++] = value;
+        ptr = endptr;
+
+        if (*ptr == ',')
+        {
+            ++ptr;
+        }
+        else if (*ptr != '\0')
+        {
+            return -1;
+        }
+    }
+
+    return count;
+}
+
+// Parses a comma separated list of sizes, returns the count or -1 on error.
+int parse_size_list(const char *str, size_t *values, size_t max_count)
+{
+    char *copy = strdup(str);
+    if (!copy)
+    {
+        perror("strdup");
+        return -1;
+    }
+
+    int count = 0;
+    char *saveptr;
+    for (char *token = strtok_r(copy, ",", &saveptr); token; token = strtok_r(NULL, ",", &saveptr))
+    {
+        size_t value = parse_size(token);
+        if ((value == 0) || ((size_t) count == max_count))
+        {
+            count = -1;
+            break;
+        }
+        values[count++] = value;
+    }
+
+    free(copy);
+    return count;
+}
+
+int cpu_set_to_str(const cpu_set_t *cpu_set, char *buf, size_t buf_size)
+{
+    buf[0] = '[';
+    size_t result_size = 1;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, cpu_set))
+        {
+            int chars_written = snprintf(buf+result_size, buf_size-result_size, "%s%d",
+                    result_size == 1 ? "" : ", ", cpu);
+            if ((chars_written < 0) || ((size_t) chars_written >= (buf_size-result_size)))
+            {
+                ERROR("CPU list string truncated\n");
+                return -1;
+            }
+            result_size += chars_written;
+        }
+    }
+    snprintf(buf+result_size, buf_size-result_size, "]");
+
+    return 0;
+}
+
+int parse_syscall_mix(const char *str, size_t *syscalls)
+{
+    memset(syscalls, 0, SYSCALL_KIND_COUNT * sizeof(size_t));
+
+    const char *ptr = str;
+    while (*ptr != '\0')
+    {
+        const char *colon = strchr(ptr, ':');
+        if (!colon)
+        {
+            return -1;
+        }
+
+        int kind;
+        for (kind = 0; kind < SYSCALL_KIND_COUNT; ++kind)
+        {
+            if ((strlen(syscall_names[kind]) == (size_t) (colon - ptr)) &&
+                    (strncmp(ptr, syscall_names[kind], colon - ptr) == 0))
+            {
+                break;
+            }
+        }
+        if (kind == SYSCALL_KIND_COUNT)
+        {
+            return -1;
+        }
+
+        char *endptr;
+        long count = strtol(colon+1, &endptr, 10);
+        if ((endptr == colon+1) || (count < 0))
+        {
+            return -1;
+        }
+        syscalls[kind] = count;
+
+        ptr = endptr;
+        if (*ptr == ',')
+        {
+            ++ptr;
+        }
+        else if (*ptr != '\0')
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int syscall_mix_to_str(const size_t *syscalls, char *buf, size_t buf_size, bool json)
+{
+    size_t result_size = 0;
+    buf[0] = '\0';
+    for (int kind = 0; kind < SYSCALL_KIND_COUNT; ++kind)
+    {
+        if (!json && (syscalls[kind] == 0))
+        {
+            continue;
+        }
+        int chars_written = snprintf(buf+result_size, buf_size-result_size, json ? "%s\"%s\": %zu" : "%s%s:%zu",
+                result_size == 0 ? "" : ", ", syscall_names[kind], syscalls[kind]);
+        if ((chars_written < 0) || ((size_t) chars_written >= (buf_size-result_size)))
+        {
+            ERROR("Syscall mix string truncated\n");
+            return -1;
+        }
+        result_size += chars_written;
+    }
+    return 0;
+}
+
 void show_version(const char *argv0)
 {
     printf("%s\n", PACKAGE_STRING);
@@ -162,11 +735,26 @@ void show_help(const char *argv0)
     printf("-v, --verbose[=VERBOSITY]\n");
     printf("    Set amount of verbosity: 0 for errors only, 1 for warnings, 2 for info (default), 3 for debug.\n");
     printf("-m, --memory_total\n");
-    printf("    Set total amount of memory to allocate both in parent and child. Default is 4 MB.\n");
+    printf("    Set total amount of memory to allocate both in parent and child. Default is 4 MB. Not available in\n");
+    printf("    conflict mode, where the working set is conflict_lines cache lines.\n");
     printf("-a, --access_per_cache_line\n");
     printf("    Specify amount of memory accesses per cache line. Default is 1.\n");
     printf("-i, --iterations_per_yield\n");
     printf("    Specify amount of iterations during each scheduled slot. Default is 1.\n");
+    printf("--reuse=PERCENT\n");
+    printf("    Set the share of the working set that every slice reuses from the previous one. The other lines of a\n");
+    printf("    slice are a window that moves through a larger pool, so that they are only touched again after\n");
+    printf("    reuse_pool slices. The working set per slice stays memory_total. Defaults to 100.\n");
+    printf("--reuse_pool=MULT\n");
+    printf("    Set the size of the pool as a multiple of the window. Defaults to 8.\n");
+    printf("--workload=data|code\n");
+    printf("    Choose what each task runs during its slot. 'data' accesses a working set of memory_total bytes. 'code'\n");
+    printf("    calls in sequence a set of distinct functions generated at build time, to measure the hotness of the\n");
+    printf("    instruction cache and iTLB. Every task runs its own functions. In the code workload the access rates count\n");
+    printf("    cache lines of code, and access_per_cache_line must stay 1. Defaults to data.\n");
+    printf("--code_footprint=SIZE\n");
+    printf("    Set the amount of code every task runs per iteration in the code workload, rounded to whole functions.\n");
+    printf("    At most an equal share of the generated code per task. Defaults to 64 KB.\n");
     printf("-y, --yield_count\n");
     printf("    Set yield count. Defaults to 16.\n");
     printf("-c, --concurrent[=yes|no]\n");
@@ -175,10 +763,105 @@ void show_help(const char *argv0)
     printf("    Defaults to yes.\n");
     printf("-f, --fifo_priority\n");
     printf("    Set the SCHED_FIFO priority. Defaults to 1.\n"); 
-    printf("-c, --cpu\n");
-    printf("    Choose the CPU core to run on. Defaults to cpu_count-1.\n");
+    printf("-p, --cpu\n");
+    printf("    Choose the CPU core to run on. Defaults to cpu_count-1. Up to version 1.4 the tasks ran on the CPU\n");
+    printf("    before the chosen one, while the frequency and the caches were read from the chosen one.\n");
+    printf("--freq_tolerance=REL\n");
+    printf("    Measure the effective frequency of every task and phase from the cycles and reference cycles perf\n");
+    printf("    counters, or from the APERF and MPERF registers if perf is not available. Warn if it varies by more than\n");
+    printf("    REL (relative), and discard such runs with --until_stable. Execution times are also reported in cycles.\n");
+    printf("    If perf only allows counting user space, the frequency is derived from the ratio of the counters.\n");
+    printf("    Defaults to 0.05.\n");
+    printf("--freq_slices\n");
+    printf("    Also measure the effective frequency of every slice. Reading the counters adds a syscall to every slice.\n");
+    printf("--prefault=none|touch|populate|mlock\n");
+    printf("    Set how the working set is faulted in before the timed region. 'none' leaves the first touch to the\n");
+    printf("    timed region, 'touch' writes every cache line once, 'populate' maps the memory with MAP_POPULATE and\n");
+    printf("    'mlock' locks all current and future pages with mlockall(). Defaults to mlock.\n");
+    printf("--backing=anon|shm|shm_hugetlb|file:PATH\n");
+    printf("    Set what the working set is mapped from: anonymous memory, a memfd of its own for every task ('shm', or\n");
+    printf("    'shm_hugetlb' for one from the hugetlb pool), or the file PATH, e.g. on a tmpfs. The file is extended as\n");
+    printf("    needed and every task maps its own range of it, so that the tasks don't share pages. A campaign on more\n");
+    printf("    than one CPU uses the file PATH.cpuN for the workers on CPU N. Defaults to anon.\n");
+    printf("--mapping=private|shared\n");
+    printf("    Map the working set with MAP_PRIVATE or MAP_SHARED. As the work writes to every line, a private mapping\n");
+    printf("    of a file or memfd copies every page on the first write. Defaults to private.\n");
+    printf("--madvise=none|random|sequential|willneed|hugepage|nohugepage\n");
+    printf("    Give the kernel a madvise() hint for the working set after mapping it. Defaults to none.\n");
+    printf("--conflict=LEVEL\n");
+    printf("    Build the working set from lines that are (sets * cache line size) apart, so that they all map to the\n");
+    printf("    same set of the level LEVEL data cache. Both tasks use the same set. When the distance exceeds the page\n");
+    printf("    size, the set is picked by the physical address, so --backing=shm_hugetlb is required and the distance\n");
+    printf("    must not exceed the huge page size. Off by default.\n");
+    printf("--conflict_lines=N\n");
+    printf("    Set the number of conflicting lines per task in conflict mode. Defaults to the associativity.\n");
+    printf("--syscalls=MIX\n");
+    printf("    Make syscalls at every yield point to let the kernel pollute the caches. MIX is a comma separated list\n");
+    printf("    of KIND:COUNT, where KIND is one of: read (small read from a tmpfs file), write (small write to a\n");
+    printf("    pipe), getpid, futex (wake without waiters), epoll (poll without timeout). E.g. read:4,getpid:8.\n");
+    printf("    Off by default.\n");
+    printf("--audit[=warn|refuse]\n");
+    printf("    Audit the measured CPU for noise before the run: governor, turbo, isolated and nohz_full CPUs,\n");
+    printf("    interrupts and the interruption gaps seen by a busy-loop. The findings are combined into a score from\n");
+    printf("    0 to 100. The runnable tasks of the whole system are reported, but not scored. If the score is below\n");
+    printf("    the threshold, 'warn' prints a warning and 'refuse' exits without running. Defaults to warn if the\n");
+    printf("    mode is omitted. In a campaign every campaign CPU is audited, and its score is added to the lines of\n");
+    printf("    the measurements run on it. Off by default.\n");
+    printf("--audit_duration=MS\n");
+    printf("    Set the duration of the busy-loop in the audit. Defaults to 1000.\n");
+    printf("--audit_threshold=SCORE\n");
+    printf("    Set the lowest acceptable audit score. Defaults to 70.\n");
+    printf("--coroutines=N\n");
+    printf("    Run N tasks as stackful coroutines on a single thread instead of two processes. Tasks switch in user\n");
+    printf("    space at the points where processes call sched_yield(), without entering the kernel. Task 0 behaves\n");
+    printf("    like the parent and the other tasks like the child. N is 2 to 256. Off by default.\n");
+    printf("--until_stable=REL_ERR\n");
+    printf("    Repeat pairs of concurrent and sequential runs until the 95%% confidence interval of the concurrency\n");
+    printf("    penalty, the difference of their average execution times, is within REL_ERR of the penalty (e.g. 0.05).\n");
+    printf("    The results of the last concurrent run are written along with the statistics. Off by default.\n");
+    printf("--time_budget=SECONDS\n");
+    printf("    Stop repeating runs for --until_stable after SECONDS even if the target is not reached. Defaults to 300.\n");
+    printf("--fit_refill[=LIST]\n");
+    printf("    Measure the refill cost of a switch: repeat the run with iterations_per_yield set to every value of the\n");
+    printf("    comma separated LIST, and once with no iterations at all. A line fitted to the time per slice against\n");
+    printf("    the iterations gives the cost of one pass as the slope and the refill cost as the intercept minus the\n");
+    printf("    time per slice without iterations. The results of the last run are written along with the fit.\n");
+    printf("    LIST defaults to 1,2,3,4,6,8. Needs --concurrent=yes. Off by default.\n");
+    printf("--warm=none|prefetch|touch\n");
+    printf("    Warm up the working set at the start of every slice, before the work: 'prefetch' issues a software\n");
+    printf("    prefetch for every cache line, 'touch' reads one word of every cache line. The warm-up and the work are\n");
+    printf("    timed separately. A prefetch only starts the transfer, so part of its cost shows up in the work time.\n");
+    printf("    Defaults to none.\n");
+    printf("--warm_prefix=SIZE\n");
+    printf("    Only warm up the first SIZE bytes of the working set. Defaults to all of it.\n");
     printf("-o, --outfile\n");
     printf("    Specify output file. If no file is given, only stdout is used. The output file is JSON formatted.\n");
+    printf("    The access rates, bandwidths and ns per access are computed from the time the tasks spent in their work\n");
+    printf("    passes, as the execution times also hold the slices of the other tasks on the CPU.\n");
+    printf("--antagonist_cpus=LIST\n");
+    printf("    Run a noisy neighbor on each CPU in LIST (e.g. 0-2,5) during the measurement. Off by default.\n");
+    printf("--antagonist_mode=llc|bandwidth\n");
+    printf("    Set what the noisy neighbors do: 'llc' thrashes the shared cache by touching lines in a scattered\n");
+    printf("    order, 'bandwidth' streams through memory to saturate the memory bus. Defaults to llc.\n");
+    printf("--antagonist_footprint=SIZE\n");
+    printf("    Set the amount of memory each noisy neighbor touches. Defaults to twice the size of the last level cache.\n");
+    printf("--progress[=INTERVAL]\n");
+    printf("    Print live progress of both tasks every INTERVAL milliseconds. Defaults to 1000 if INTERVAL is omitted.\n");
+    printf("    The reporter runs on the other CPUs and reads the progress from shared memory.\n");
+    printf("--progress_file=PATH\n");
+    printf("    Write live progress to PATH instead of stdout, e.g. to follow it with tail -f. Implies --progress.\n");
+    printf("--campaign_cpus=LIST\n");
+    printf("    Run a campaign: every memory size of --campaign_memory is an independent measurement, and up to one\n");
+    printf("    measurement runs on each CPU in LIST (e.g. 2-7) at the same time. The results are streamed as one line of\n");
+    printf("    JSON per measurement, with the CPU it ran on, to the outfile or to stdout. When the lines go to stdout,\n");
+    printf("    all other messages go to stderr. Off by default.\n");
+    printf("--campaign_memory=LIST\n");
+    printf("    Set the memory_total of every measurement of the campaign (e.g. 64k,256k,1M,4M).\n");
+    printf("--campaign_reuse=LIST\n");
+    printf("    Also sweep the reuse percentage (e.g. 100,75,50,25,0): every memory size is measured with every value.\n");
+    printf("--campaign_separate_llc\n");
+    printf("    Only use campaign CPUs that don't share the last level cache with each other, so that measurements running\n");
+    printf("    at the same time don't evict each other.\n");
     printf("\n");
 
     printf("Examples:\n");
@@ -188,9 +871,54 @@ void show_help(const char *argv0)
     printf("    Run with concurrency off.\n");
     printf("%s -o data.json\n", argv0);
     printf("    Write test results to file data.json.\n");
+    printf("for n in 4 8 12 16 24; do %s --conflict=1 --conflict_lines=$n --concurrent=yes; done\n", argv0);
+    printf("    Sweep the per-set footprint across the L1 associativity. Repeat with --concurrent=no to compare one task\n");
+    printf("    against two time-sharing tasks.\n");
+    printf("%s --concurrent=no --antagonist_cpus=0-1\n", argv0);
+    printf("    Run with concurrency off while CPUs 0 and 1 thrash the shared cache. Compare against runs with\n");
+    printf("    concurrency on to see how much of the cache hotness benefit remains under shared cache pressure.\n");
+    printf("%s --campaign_cpus=2-7 --campaign_memory=64k,256k,1M,4M,16M,64M -o sweep.jsonl\n", argv0);
+    printf("    Sweep the memory size on six CPUs in parallel, writing one line of JSON per memory size.\n");
+    printf("%s --campaign_cpus=2-7 --campaign_memory=1M --campaign_reuse=100,75,50,25,0 --concurrent=no\n", argv0);
+    printf("    Measure how the hotness benefit decays as reuse falls. Repeat with --concurrent=yes and compare the\n");
+    printf("    execution times at each reuse percentage.\n");
     printf("\n");
 }
 
+enum long_only_options {
+    OPTION_ANTAGONIST_CPUS = 256,
+    OPTION_ANTAGONIST_MODE,
+    OPTION_ANTAGONIST_FOOTPRINT,
+    OPTION_PROGRESS,
+    OPTION_PROGRESS_FILE,
+    OPTION_PREFAULT,
+    OPTION_CONFLICT,
+    OPTION_CONFLICT_LINES,
+    OPTION_SYSCALLS,
+    OPTION_AUDIT,
+    OPTION_AUDIT_DURATION,
+    OPTION_AUDIT_THRESHOLD,
+    OPTION_COROUTINES,
+    OPTION_UNTIL_STABLE,
+    OPTION_TIME_BUDGET,
+    OPTION_WARM,
+    OPTION_WARM_PREFIX,
+    OPTION_WORKLOAD,
+    OPTION_CODE_FOOTPRINT,
+    OPTION_FIT_REFILL,
+    OPTION_CAMPAIGN_CPUS,
+    OPTION_CAMPAIGN_MEMORY,
+    OPTION_CAMPAIGN_SEPARATE_LLC,
+    OPTION_FREQ_TOLERANCE,
+    OPTION_FREQ_SLICES,
+    OPTION_REUSE,
+    OPTION_REUSE_POOL,
+    OPTION_CAMPAIGN_REUSE,
+    OPTION_BACKING,
+    OPTION_MAPPING,
+    OPTION_MADVISE,
+};
+
 int parse_options(struct settings *settings, int argc, char **argv)
 {
     const struct option long_options[] = {
@@ -202,7 +930,38 @@ int parse_options(struct settings *settings, int argc, char **argv)
         {"concurrent", optional_argument, 0, 'c'},
         {"fifo_priority", required_argument, 0, 'f'},
         {"cpu", required_argument, 0, 'p'},
+        {"prefault", required_argument, 0, OPTION_PREFAULT},
+        {"conflict", required_argument, 0, OPTION_CONFLICT},
+        {"conflict_lines", required_argument, 0, OPTION_CONFLICT_LINES},
+        {"syscalls", required_argument, 0, OPTION_SYSCALLS},
+        {"audit", optional_argument, 0, OPTION_AUDIT},
+        {"audit_duration", required_argument, 0, OPTION_AUDIT_DURATION},
+        {"audit_threshold", required_argument, 0, OPTION_AUDIT_THRESHOLD},
+        {"coroutines", required_argument, 0, OPTION_COROUTINES},
+        {"until_stable", required_argument, 0, OPTION_UNTIL_STABLE},
+        {"time_budget", required_argument, 0, OPTION_TIME_BUDGET},
+        {"warm", required_argument, 0, OPTION_WARM},
+        {"warm_prefix", required_argument, 0, OPTION_WARM_PREFIX},
+        {"workload", required_argument, 0, OPTION_WORKLOAD},
+        {"code_footprint", required_argument, 0, OPTION_CODE_FOOTPRINT},
+        {"fit_refill", optional_argument, 0, OPTION_FIT_REFILL},
+        {"campaign_cpus", required_argument, 0, OPTION_CAMPAIGN_CPUS},
+        {"campaign_memory", required_argument, 0, OPTION_CAMPAIGN_MEMORY},
+        {"campaign_separate_llc", no_argument, 0, OPTION_CAMPAIGN_SEPARATE_LLC},
+        {"freq_tolerance", required_argument, 0, OPTION_FREQ_TOLERANCE},
+        {"freq_slices", no_argument, 0, OPTION_FREQ_SLICES},
+        {"reuse", required_argument, 0, OPTION_REUSE},
+        {"reuse_pool", required_argument, 0, OPTION_REUSE_POOL},
+        {"campaign_reuse", required_argument, 0, OPTION_CAMPAIGN_REUSE},
+        {"backing", required_argument, 0, OPTION_BACKING},
+        {"mapping", required_argument, 0, OPTION_MAPPING},
+        {"madvise", required_argument, 0, OPTION_MADVISE},
         {"outfile", required_argument, 0, 'o'},
+        {"antagonist_cpus", required_argument, 0, OPTION_ANTAGONIST_CPUS},
+        {"antagonist_mode", required_argument, 0, OPTION_ANTAGONIST_MODE},
+        {"antagonist_footprint", required_argument, 0, OPTION_ANTAGONIST_FOOTPRINT},
+        {"progress", optional_argument, 0, OPTION_PROGRESS},
+        {"progress_file", required_argument, 0, OPTION_PROGRESS_FILE},
         {"version", no_argument, 0, 'V'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0},
@@ -236,6 +995,11 @@ int parse_options(struct settings *settings, int argc, char **argv)
                 break;
             case 'm':
                 settings->memory_total = parse_size(optarg);
+                if (settings->memory_total == 0)
+                {
+                    printf("ERROR: memory_total cannot be set to '%s'\n", optarg);
+                    return -1;
+                }
                 break;
             case 'a':
                 settings->access_per_cache_line = atoi(optarg);
@@ -278,54 +1042,364 @@ int parse_options(struct settings *settings, int argc, char **argv)
             case 'o':
                 strcpy(settings->outfile, optarg);
                 break;
-            case 'V':
-                show_version(argv[0]);
-                exit(EXIT_SUCCESS);
-            case 'h':
-            case '?':
-                show_help(argv[0]);
-                return -1;
-            default:
-                printf("?? getopt returned character code 0%o ??\n", c);
-        }
-    }
-
-    return 0;
-}
-
-int get_cpu_count()
-{
-    int cpu_count = get_nprocs();  // this is "expensive"
-    //long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
-
-    return cpu_count;
-}
-
-int get_cache_line_size()
-{
-    const char SYS_PATH[] = "/sys/devices/system/cpu/cpu0/cache/index0/coherency_line_size";
-    int fd = open(SYS_PATH, O_RDONLY | O_CLOEXEC);
-    if (fd == -1)
-    {
-        perror("open");
-        return -1;
-    }
-
-    char buf[32];
-    ssize_t bytes_read = read(fd, buf, sizeof(buf)-1);
-    close(fd);
-    if (bytes_read == -1)
-    {
-        perror("read");
-        return -1;
-    }
-
-    char *endptr;
-    ssize_t cache_line_size = strtol(buf, &endptr, 10);
-    if (endptr != buf && (*endptr == '\0' || *endptr == '\n'))
-    {
-        return cache_line_size;
-    }
+            case OPTION_ANTAGONIST_CPUS:
+                if (parse_cpu_list(optarg, &settings->antagonist_cpus))
+                {
+                    printf("ERROR: invalid CPU list '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPTION_ANTAGONIST_MODE:
+                if (strcmp(optarg, "llc") == 0)
+                {
+                    settings->antagonist_mode = ANTAGONIST_LLC;
+                }
+                else if (strcmp(optarg, "bandwidth") == 0)
+                {
+                    settings->antagonist_mode = ANTAGONIST_BANDWIDTH;
+                }
+                else
+                {
+                    printf("ERROR: antagonist_mode cannot be set to '%s'\n", optarg);
+                    printf("Allowed values for antagonist_mode are: 'llc', 'bandwidth'\n");
+                    return -1;
+                }
+                break;
+            case OPTION_ANTAGONIST_FOOTPRINT:
+                settings->antagonist_footprint = parse_size(optarg);
+                break;
+            case OPTION_PREFAULT:
+                if (strcmp(optarg, "none") == 0)
+                {
+                    settings->prefault = PREFAULT_NONE;
+                }
+                else if (strcmp(optarg, "touch") == 0)
+                {
+                    settings->prefault = PREFAULT_TOUCH;
+                }
+                else if (strcmp(optarg, "populate") == 0)
+                {
+                    settings->prefault = PREFAULT_POPULATE;
+                }
+                else if (strcmp(optarg, "mlock") == 0)
+                {
+                    settings->prefault = PREFAULT_MLOCK;
+                }
+                else
+                {
+                    printf("ERROR: prefault cannot be set to '%s'\n", optarg);
+                    printf("Allowed values for prefault are: 'none', 'touch', 'populate', 'mlock'\n");
+                    return -1;
+                }
+                break;
+            case OPTION_BACKING:
+                if (strcmp(optarg, "anon") == 0)
+                {
+                    settings->backing = BACKING_ANON;
+                }
+                else if (strcmp(optarg, "shm") == 0)
+                {
+                    settings->backing = BACKING_SHM;
+                }
+                else if (strcmp(optarg, "shm_hugetlb") == 0)
+                {
+                    settings->backing = BACKING_SHM_HUGETLB;
+                }
+                else if ((strncmp(optarg, "file:", 5) == 0) && (strlen(optarg) > 5))
+                {
+                    if (strlen(optarg + 5) >= sizeof(settings->backing_path))
+                    {
+                        printf("ERROR: backing file path is longer than %zu characters\n",
+                                sizeof(settings->backing_path) - 1);
+                        return -1;
+                    }
+                    settings->backing = BACKING_FILE;
+                    strcpy(settings->backing_path, optarg + 5);
+                }
+                else
+                {
+                    printf("ERROR: backing cannot be set to '%s'\n", optarg);
+                    printf("Allowed values for backing are: 'anon', 'shm', 'shm_hugetlb', 'file:PATH'\n");
+                    return -1;
+                }
+                break;
+            case OPTION_MAPPING:
+                if (strcmp(optarg, "private") == 0)
+                {
+                    settings->mapping_shared = false;
+                }
+                else if (strcmp(optarg, "shared") == 0)
+                {
+                    settings->mapping_shared = true;
+                }
+                else
+                {
+                    printf("ERROR: mapping cannot be set to '%s'\n", optarg);
+                    printf("Allowed values for mapping are: 'private', 'shared'\n");
+                    return -1;
+                }
+                break;
+            case OPTION_MADVISE:
+            {
+                size_t hint = 0;
+                while ((hint < sizeof(madvise_names) / sizeof(madvise_names[0])) &&
+                        (strcmp(optarg, madvise_names[hint]) != 0))
+                {
+                    ++hint;
+                }
+                if (hint == sizeof(madvise_names) / sizeof(madvise_names[0]))
+                {
+                    printf("ERROR: madvise cannot be set to '%s'\n", optarg);
+                    return -1;
+                }
+                settings->madvise_hint = hint;
+                break;
+            }
+            case OPTION_CONFLICT:
+                settings->conflict_level = atoi(optarg);
+                if (settings->conflict_level <= 0)
+                {
+                    printf("ERROR: conflict cannot be set to '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPTION_CONFLICT_LINES:
+                settings->conflict_lines = atoi(optarg);
+                break;
+            case OPTION_SYSCALLS:
+                if (parse_syscall_mix(optarg, settings->syscalls))
+                {
+                    printf("ERROR: invalid syscall mix '%s'\n", optarg);
+                    printf("Allowed syscalls are: 'read', 'write', 'getpid', 'futex', 'epoll'\n");
+                    return -1;
+                }
+                break;
+            case OPTION_AUDIT:
+                if ((optarg == NULL) || (strcmp(optarg, "warn") == 0))
+                {
+                    settings->audit_mode = AUDIT_WARN;
+                }
+                else if (strcmp(optarg, "refuse") == 0)
+                {
+                    settings->audit_mode = AUDIT_REFUSE;
+                }
+                else
+                {
+                    printf("ERROR: audit cannot be set to '%s'\n", optarg);
+                    printf("Allowed values for audit are: 'warn', 'refuse'\n");
+                    return -1;
+                }
+                break;
+            case OPTION_AUDIT_DURATION:
+                settings->audit_duration = atoi(optarg);
+                break;
+            case OPTION_AUDIT_THRESHOLD:
+                settings->audit_threshold = atoi(optarg);
+                break;
+            case OPTION_COROUTINES:
+            {
+                int count = atoi(optarg);
+                if ((count < 2) || (count > COROUTINE_MAX_COUNT))
+                {
+                    printf("ERROR: coroutines must be between 2 and %d, got '%s'\n", COROUTINE_MAX_COUNT, optarg);
+                    return -1;
+                }
+                settings->coroutine_count = count;
+                break;
+            }
+            case OPTION_UNTIL_STABLE:
+                settings->until_stable = atof(optarg);
+                if (settings->until_stable <= 0.0)
+                {
+                    printf("ERROR: until_stable cannot be set to '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPTION_TIME_BUDGET:
+                settings->time_budget = atof(optarg);
+                break;
+            case OPTION_WARM:
+                if (strcmp(optarg, "none") == 0)
+                {
+                    settings->warm = WARM_NONE;
+                }
+                else if (strcmp(optarg, "prefetch") == 0)
+                {
+                    settings->warm = WARM_PREFETCH;
+                }
+                else if (strcmp(optarg, "touch") == 0)
+                {
+                    settings->warm = WARM_TOUCH;
+                }
+                else
+                {
+                    printf("ERROR: warm cannot be set to '%s'\n", optarg);
+                    printf("Allowed values for warm are: 'none', 'prefetch', 'touch'\n");
+                    return -1;
+                }
+                break;
+            case OPTION_WARM_PREFIX:
+                settings->warm_prefix = parse_size(optarg);
+                break;
+            case OPTION_WORKLOAD:
+                if (strcmp(optarg, "data") == 0)
+                {
+                    settings->workload = WORKLOAD_DATA;
+                }
+                else if (strcmp(optarg, "code") == 0)
+                {
+                    settings->workload = WORKLOAD_CODE;
+                }
+                else
+                {
+                    printf("ERROR: workload cannot be set to '%s'\n", optarg);
+                    printf("Allowed values for workload are: 'data', 'code'\n");
+                    return -1;
+                }
+                break;
+            case OPTION_CODE_FOOTPRINT:
+                settings->code_footprint = parse_size(optarg);
+                break;
+            case OPTION_FIT_REFILL:
+            {
+                int points = parse_number_list(optarg == NULL ? "1,2,3,4,6,8" : optarg, settings->fit_iterations,
+                        FIT_MAX_POINTS);
+                if (points < 2)
+                {
+                    printf("ERROR: fit_refill needs 2 to %d iterations, got '%s'\n", FIT_MAX_POINTS, optarg);
+                    return -1;
+                }
+                settings->fit_points = points;
+                break;
+            }
+            case OPTION_CAMPAIGN_CPUS:
+                if (parse_cpu_list(optarg, &settings->campaign_cpus))
+                {
+                    printf("ERROR: invalid CPU list '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPTION_CAMPAIGN_MEMORY:
+            {
+                int points = parse_size_list(optarg, settings->campaign_memory, CAMPAIGN_MAX_POINTS);
+                if (points < 1)
+                {
+                    printf("ERROR: campaign_memory needs 1 to %d sizes, got '%s'\n", CAMPAIGN_MAX_POINTS, optarg);
+                    return -1;
+                }
+                settings->campaign_points = points;
+                break;
+            }
+            case OPTION_CAMPAIGN_SEPARATE_LLC:
+                settings->campaign_separate_llc = true;
+                break;
+            case OPTION_FREQ_TOLERANCE:
+                settings->freq_tolerance = atof(optarg);
+                if (settings->freq_tolerance <= 0.0)
+                {
+                    printf("ERROR: freq_tolerance cannot be set to '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPTION_FREQ_SLICES:
+                settings->freq_slices = true;
+                break;
+            case OPTION_REUSE:
+                settings->reuse = atoi(optarg);
+                if ((atoi(optarg) < 0) || (settings->reuse > 100))
+                {
+                    printf("ERROR: reuse cannot be set to '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPTION_REUSE_POOL:
+                settings->reuse_pool = atoi(optarg);
+                if (atoi(optarg) < 1)
+                {
+                    printf("ERROR: reuse_pool cannot be set to '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case OPTION_CAMPAIGN_REUSE:
+            {
+                int points = parse_number_list(optarg, settings->campaign_reuse, CAMPAIGN_MAX_POINTS);
+                bool valid = points >= 1;
+                for (int i = 0; i < points; ++i)
+                {
+                    valid &= settings->campaign_reuse[i] <= 100;
+                }
+                if (!valid)
+                {
+                    printf("ERROR: campaign_reuse needs 1 to %d percentages, got '%s'\n", CAMPAIGN_MAX_POINTS, optarg);
+                    return -1;
+                }
+                settings->campaign_reuse_count = points;
+                break;
+            }
+            case OPTION_PROGRESS:
+                settings->progress_interval = optarg == NULL ? 1000 : atoi(optarg);
+                break;
+            case OPTION_PROGRESS_FILE:
+                if (strlen(optarg) >= sizeof(settings->progress_file))
+                {
+                    printf("ERROR: progress_file path is longer than %zu characters\n",
+                            sizeof(settings->progress_file) - 1);
+                    return -1;
+                }
+                strcpy(settings->progress_file, optarg);
+                if (settings->progress_interval == 0)
+                {
+                    settings->progress_interval = 1000;
+                }
+                break;
+            case 'V':
+                show_version(argv[0]);
+                exit(EXIT_SUCCESS);
+            case 'h':
+            case '?':
+                show_help(argv[0]);
+                return -1;
+            default:
+                printf("?? getopt returned character code 0%o ??\n", c);
+        }
+    }
+
+    return 0;
+}
+
+int get_cpu_count()
+{
+    int cpu_count = get_nprocs();  // this is "expensive"
+    //long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return cpu_count;
+}
+
+int get_cache_line_size()
+{
+    const char SYS_PATH[] = "/sys/devices/system/cpu/cpu0/cache/index0/coherency_line_size";
+    int fd = open(SYS_PATH, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        perror("open");
+        return -1;
+    }
+
+    char buf[32];
+    ssize_t bytes_read = read(fd, buf, sizeof(buf)-1);
+    close(fd);
+    if (bytes_read == -1)
+    {
+        perror("read");
+        return -1;
+    }
+
+    char *endptr;
+    ssize_t cache_line_size = strtol(buf, &endptr, 10);
+    if (endptr != buf && (*endptr == '\0' || *endptr == '\n'))
+    {
+        return cache_line_size;
+    }
     return -1;
 }
 
@@ -506,6 +1580,105 @@ int get_cache_sizes(size_t cpu, size_t *cache_sizes, size_t buf_size)
     return highest_index+1;
 }
 
+ssize_t read_sysfs_str(const char *path, char *buf, size_t buf_size)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        perror("open");
+        return -1;
+    }
+
+    ssize_t bytes_read = read(fd, buf, buf_size-1);
+    close(fd);
+    if (bytes_read == -1)
+    {
+        perror("read");
+        return -1;
+    }
+    buf[bytes_read] = '\0';
+    if ((bytes_read > 0) && (buf[bytes_read-1] == '\n'))
+    {
+        buf[--bytes_read] = '\0';
+    }
+
+    return bytes_read;
+}
+
+// Finds the instruction cache of the given level, or the data or unified one. Unlike get_cache_size(), which only
+// looks at the latter.
+int get_cache_info(size_t cpu, int level, bool instruction, struct cache_info *info)
+{
+    char BASE_PATH[64]; // fits any CPU number, so that every attribute path below fits PATH
+    snprintf(BASE_PATH, sizeof(BASE_PATH), "/sys/devices/system/cpu/cpu%zu/cache", cpu);
+
+    for (int index = 0; index < 10; ++index)
+    {
+        char PATH[PATH_MAX];
+        char buf[32];
+
+        snprintf(PATH, sizeof(PATH), "%s/index%d/level", BASE_PATH, index);
+        if (access(PATH, R_OK))
+        {
+            break;
+        }
+        if (read_sysfs_str(PATH, buf, sizeof(buf)) <= 0)
+        {
+            return -1;
+        }
+        if (atoi(buf) != level)
+        {
+            continue;
+        }
+
+        snprintf(PATH, sizeof(PATH), "%s/index%d/type", BASE_PATH, index);
+        if (read_sysfs_str(PATH, info->type, sizeof(info->type)) <= 0)
+        {
+            return -1;
+        }
+        if ((strcmp(info->type, "Instruction") == 0) != instruction)
+        {
+            continue;
+        }
+        info->level = level;
+
+        snprintf(PATH, sizeof(PATH), "%s/index%d/size", BASE_PATH, index);
+        if (read_sysfs_str(PATH, buf, sizeof(buf)) <= 0)
+        {
+            return -1;
+        }
+        info->size = parse_size(buf);
+
+        snprintf(PATH, sizeof(PATH), "%s/index%d/coherency_line_size", BASE_PATH, index);
+        if (read_sysfs_str(PATH, buf, sizeof(buf)) <= 0)
+        {
+            return -1;
+        }
+        info->line_size = atoi(buf);
+
+        snprintf(PATH, sizeof(PATH), "%s/index%d/number_of_sets", BASE_PATH, index);
+        if (read_sysfs_str(PATH, buf, sizeof(buf)) <= 0)
+        {
+            return -1;
+        }
+        info->sets = atoi(buf);
+
+        snprintf(PATH, sizeof(PATH), "%s/index%d/ways_of_associativity", BASE_PATH, index);
+        if (read_sysfs_str(PATH, buf, sizeof(buf)) <= 0)
+        {
+            return -1;
+        }
+        info->ways = atoi(buf);
+
+        DEBUG("L%d %s cache: %zu bytes, %zu sets, %zu ways\n", info->level, info->type, info->size, info->sets,
+                info->ways);
+        return 0;
+    }
+
+    DEBUG("No level %d %s cache found for CPU %zu\n", level, instruction ? "instruction" : "data", cpu);
+    return -1;
+}
+
 int get_cache_sizes_str(char *buf, size_t buf_size, size_t cpu, bool human)
 {
     ssize_t cache_sizes[10];
@@ -551,407 +1724,3783 @@ int get_cache_sizes_str(char *buf, size_t buf_size, size_t cpu, bool human)
     return 0;
 }
 
-int set_affinity(int cpu)
+long timespec_to_ns(struct timespec time)
 {
-    int cpu_dest = cpu - 1;
+    return time.tv_sec * 1000 * 1000 * 1000 + time.tv_nsec;
+}
 
-    cpu_set_t cpu_set;
-    CPU_ZERO(&cpu_set);
-    CPU_SET(cpu_dest, &cpu_set);
+struct timespec ns_to_timespec(long time_ns)
+{
+    struct timespec time = {
+        .tv_sec = time_ns / (1000 * 1000 * 1000),
+        .tv_nsec = time_ns % (1000 * 1000 * 1000)
+    };
+    return time;
+}
 
-    if (sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set))
+void compute_rates(size_t accesses, size_t bytes, struct timespec time, struct rates *rates)
+{
+    long time_ns = timespec_to_ns(time);
+    if ((accesses == 0) || (time_ns <= 0))
     {
-        perror("sched_setaffinity");
-        return -1;
+        memset(rates, 0, sizeof(*rates));
+        return;
     }
 
-    INFO("CPU affinity set to: %d\n", cpu_dest);
-
-    return 0;
+    rates->access_rate = accesses * 1e9 / time_ns;
+    rates->bandwidth = (double) bytes / time_ns;
+    rates->ns_per_access = (double) time_ns / accesses;
 }
 
-int set_fifo_scheduling(int priority)
+void print_rates(const char *name, const struct rates *rates)
 {
-    struct sched_param params = { .sched_priority = priority };
+    INFO("Access rate %s: %.0f accesses/s, %.3f GB/s, %.3f ns/access\n",
+            name, rates->access_rate, rates->bandwidth, rates->ns_per_access);
+}
 
-    if (sched_setscheduler(0, SCHED_FIFO, &params))
+const char *freq_source_to_str(enum freq_source source)
+{
+    switch (source)
     {
-        perror("sched_setscheduler");
-        return -1;
+        case FREQ_NONE:
+            return "none";
+        case FREQ_PERF:
+            return "perf";
+        case FREQ_MSR:
+            return "msr";
     }
+    return "unknown";
+}
 
-    INFO("Scheduling algorithm set to: SCHED_FIFO\n");
-
-    return 0;
+int open_perf_event(uint64_t config, int group_fd, bool user_only)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = user_only;
+    attr.exclude_hv = user_only;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
 }
 
-int open_pipes(int parent_pipefds[], int child_pipefds[])
+void freq_counter_close(struct freq_counter *counter)
 {
-    if (pipe(parent_pipefds) == -1)
+    if (counter->ref_cycles_fd != -1)
     {
-        perror("pipe");
-        return -1;
+        close(counter->ref_cycles_fd);
     }
-
-    if (pipe(child_pipefds) == -1)
+    if (counter->cycles_fd != -1)
     {
-        perror("pipe");
-        return -1;
+        close(counter->cycles_fd);
     }
+    counter->source = FREQ_NONE;
+}
 
+#define MSR_IA32_MPERF 0xe7
+#define MSR_IA32_APERF 0xe8
+
+int freq_counter_read(const struct freq_counter *counter, struct freq_sample *sample)
+{
+    if (counter->source == FREQ_PERF)
+    {
+        // nr, time_running, cycles, ref-cycles
+        uint64_t values[4];
+        if (read(counter->cycles_fd, values, sizeof(values)) != sizeof(values))
+        {
+            return -1;
+        }
+        sample->time_ns = values[1];
+        sample->cycles = values[2];
+        sample->ref_cycles = values[3];
+        return 0;
+    }
+    if (counter->source == FREQ_MSR)
+    {
+        struct timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        if ((pread(counter->cycles_fd, &sample->cycles, sizeof(uint64_t), MSR_IA32_APERF) != sizeof(uint64_t)) ||
+                (pread(counter->cycles_fd, &sample->ref_cycles, sizeof(uint64_t), MSR_IA32_MPERF) != sizeof(uint64_t)))
+        {
+            return -1;
+        }
+        sample->time_ns = timespec_to_ns(time);
+        return 0;
+    }
+    memset(sample, 0, sizeof(*sample));
     return 0;
 }
 
-int synchronize(bool is_child, char phase, int parent_pipefds[], int child_pipefds[])
-{
-    int write_fd = is_child ? child_pipefds[1] : parent_pipefds[1];
-    int read_fd = is_child ? parent_pipefds[0] : child_pipefds[0];
+#define FREQ_CALIBRATION_NS (2 * 1000 * 1000)
 
-    if (write(write_fd, &phase, 1) == -1)
+// Measures the rate of the reference cycles over a busy loop that never enters the kernel, so that counters limited
+// to user space miss nothing. Returns reference cycles per ns, 0.0 if the counters can't be read.
+double measure_ref_ghz(const struct freq_counter *counter)
+{
+    struct freq_sample start;
+    struct freq_sample end;
+    struct timespec time_start;
+    struct timespec time_end;
+    if (freq_counter_read(counter, &start))
     {
-        perror("write");
-        return -1;
+        return 0.0;
     }
-
-    char buf;
-    if (read(read_fd, &buf, 1) == -1)
+    clock_gettime(CLOCK_MONOTONIC, &time_start); // served by the vDSO, no syscall
+    do
     {
-        perror("read");
-        return -1;
+        clock_gettime(CLOCK_MONOTONIC, &time_end);
     }
-
-    if (buf != phase)
+    while (timespec_to_ns(time_end) - timespec_to_ns(time_start) < FREQ_CALIBRATION_NS);
+    if (freq_counter_read(counter, &end))
     {
-        ERROR("ERROR: in synchronize(), expected %c but got %c\n", phase, buf);
-        return -1;
+        return 0.0;
     }
-
-    return 0;
+    return (double) (end.ref_cycles - start.ref_cycles) / (timespec_to_ns(time_end) - timespec_to_ns(time_start));
 }
 
-void initialize_settings(struct settings *settings)
+// Opens the counters of the calling task. With FREQ_NONE the first available source is picked.
+int freq_counter_open(struct freq_counter *counter, enum freq_source source, size_t cpu)
 {
-    settings->cache_line_size = get_cache_line_size();
-    settings->memory_total = 4 * 1024 * 1024; // 4 MiB
-    settings->access_per_cache_line = 1;
-    settings->iterations_per_yield = 1;
-
-    settings->yield_count = 16;
+    counter->source = FREQ_NONE;
+    counter->cycles_fd = -1;
+    counter->ref_cycles_fd = -1;
+    counter->user_only = false;
+    counter->ref_ghz = 0.0;
 
-    settings->concurrent_run = true;
-    settings->fifo_priority = 1;
+    if ((source == FREQ_NONE) || (source == FREQ_PERF))
+    {
+        // count the yields too if allowed, otherwise user space only, as with perf_event_paranoid >= 2
+        counter->user_only = false;
+        counter->cycles_fd = open_perf_event(PERF_COUNT_HW_CPU_CYCLES, -1, false);
+        if ((counter->cycles_fd == -1) && (errno == EACCES))
+        {
+            counter->user_only = true;
+            counter->cycles_fd = open_perf_event(PERF_COUNT_HW_CPU_CYCLES, -1, true);
+        }
+        if (counter->cycles_fd != -1)
+        {
+            counter->ref_cycles_fd = open_perf_event(PERF_COUNT_HW_REF_CPU_CYCLES, counter->cycles_fd,
+                    counter->user_only);
+            if (counter->ref_cycles_fd != -1)
+            {
+                counter->source = FREQ_PERF;
+                counter->ref_ghz = counter->user_only ? measure_ref_ghz(counter) : 0.0;
+                return 0;
+            }
+            close(counter->cycles_fd);
+            counter->cycles_fd = -1;
+        }
+        DEBUG("perf cycles and ref-cycles not available: %s\n", strerror(errno));
+    }
 
-    settings->cpu = get_cpu_count() - 1;
-    settings->cpu_freq_start = -1;
-    settings->cpu_freq_finish = -1;
+    if ((source == FREQ_NONE) || (source == FREQ_MSR))
+    {
+        char PATH[PATH_MAX];
+        snprintf(PATH, sizeof(PATH), "/dev/cpu/%zu/msr", cpu);
+        counter->cycles_fd = open(PATH, O_RDONLY | O_CLOEXEC);
+        if (counter->cycles_fd != -1)
+        {
+            counter->source = FREQ_MSR;
+            return 0;
+        }
+        DEBUG("%s not readable: %s\n", PATH, strerror(errno));
+    }
 
-    strcpy(settings->outfile, "");
+    return -1;
 }
 
-int configure(struct settings *settings)
+void compute_freq_phase(const struct freq_counter *counter, const struct freq_sample *start,
+        const struct freq_sample *end, struct freq_phase *phase)
 {
-    char buf[128];
+    uint64_t cycles = end->cycles - start->cycles;
+    uint64_t ref_cycles = end->ref_cycles - start->ref_cycles;
+    uint64_t time_ns = end->time_ns - start->time_ns;
+    phase->ratio = ref_cycles ? (double) cycles / ref_cycles : 0.0;
 
-    if (set_affinity(settings->cpu))
+    // Counters limited to user space miss the yields and syscalls, which time_running still includes. The ratio of
+    // the two counters is not affected, so the frequency is derived from it.
+    if (counter->ref_ghz > 0.0)
     {
-        return -1;
+        phase->ghz = phase->ratio * counter->ref_ghz;
     }
+    else
+    {
+        phase->ghz = time_ns ? (double) cycles / time_ns : 0.0;
+    }
+}
 
-    settings->cpu_freq_start = get_cpu_freq_cpuinfo(settings);
-    if (settings->cpu_freq_start == -1)
+// Reads the counters at the end of a slice and keeps track of the lowest and highest frequency of all slices.
+int track_slice_freq(const struct freq_counter *counter, const struct freq_sample *start, struct freq_results *freq)
+{
+    struct freq_sample end;
+    if (freq_counter_read(counter, &end))
     {
         return -1;
     }
-    if (settings->cpu_freq_start)
+    struct freq_phase slice;
+    compute_freq_phase(counter, start, &end, &slice);
+    if ((slice.ghz <= 0.0) || (slice.ratio <= 0.0))
     {
-        if (cpu_freq_to_str(settings->cpu_freq_start, buf, sizeof(buf)))
-        {
-            return -1;
-        }
-        INFO("CPU freq: %s\n", buf);
+        return 0;
     }
-
-    if (set_fifo_scheduling(settings->fifo_priority))
+    if ((freq->slice_ghz_min == 0.0) || (slice.ghz < freq->slice_ghz_min))
     {
-        return -1;
+        freq->slice_ghz_min = slice.ghz;
+    }
+    if (slice.ghz > freq->slice_ghz_max)
+    {
+        freq->slice_ghz_max = slice.ghz;
+    }
+    if ((freq->slice_ratio_min == 0.0) || (slice.ratio < freq->slice_ratio_min))
+    {
+        freq->slice_ratio_min = slice.ratio;
+    }
+    if (slice.ratio > freq->slice_ratio_max)
+    {
+        freq->slice_ratio_max = slice.ratio;
     }
-
     return 0;
 }
 
-void print_settings(const struct settings *settings)
-{
-    char buf[128];
-    INFO("Concurrent run: %s\n", settings->concurrent_run ? "yes" : "no");
-    INFO("Cache line size: %zu\n", settings->cache_line_size);
-    char cache_sizes_str[100];
-    get_cache_sizes_str(cache_sizes_str, sizeof(cache_sizes_str), settings->cpu, true);
-    INFO("Cache sizes: %s\n", cache_sizes_str);
-    human_readable_size(settings->memory_total, buf, sizeof(buf));
-    INFO("Memory total: %s\n", buf);
-    INFO("Accesses per cache line: %zu\n", settings->access_per_cache_line);
-    INFO("Iterations per yield: %zu\n", settings->iterations_per_yield);
-    INFO("Yield count: %zu\n", settings->yield_count);
-}
-
-int write_file(const struct settings *settings, const struct results *results)
+// Reads the CPUs that share the last level cache with the given CPU.
+int get_llc_cpus(size_t cpu, cpu_set_t *cpu_set)
 {
-    int fd = open(settings->outfile, O_WRONLY | O_CLOEXEC | O_CREAT | O_EXCL, 0644);
-    if (fd == -1)
+    char PATH[PATH_MAX];
+    int index = 0;
+    for (;;)
     {
-        perror("open");
-        return -1;
+        snprintf(PATH, sizeof(PATH), "/sys/devices/system/cpu/cpu%zu/cache/index%d", cpu, index + 1);
+        if (access(PATH, R_OK))
+        {
+            break;
+        }
+        ++index;
     }
 
-    char cache_sizes_str[100];
-    get_cache_sizes_str(cache_sizes_str, sizeof(cache_sizes_str), settings->cpu, false);
-
-    char hostname[HOST_NAME_MAX];
-    if (gethostname(hostname, HOST_NAME_MAX))
+    char buf[256];
+    snprintf(PATH, sizeof(PATH), "/sys/devices/system/cpu/cpu%zu/cache/index%d/shared_cpu_list", cpu, index);
+    if (read_sysfs_str(PATH, buf, sizeof(buf)) <= 0)
     {
-        perror("gethostname");
         return -1;
     }
-    
-
-    dprintf(fd, "{\n");
-    dprintf(fd, "   \"general\": {\n");
-    dprintf(fd, "       \"version\": \"%s\",\n", PACKAGE_VERSION);
-    dprintf(fd, "       \"hostname\": \"%s\",\n", hostname);
-    dprintf(fd, "       \"algorithm\": \"SCHED_FIFO\"\n");
-    dprintf(fd, "   },\n");
-    dprintf(fd, "   \"cpu\": {\n");
-    dprintf(fd, "       \"id\": %zu,\n", settings->cpu);
-    dprintf(fd, "       \"cpu_freq_start\": %zu,\n", settings->cpu_freq_start);
-    dprintf(fd, "       \"cpu_freq_finish\": %zu,\n", settings->cpu_freq_finish);
-    dprintf(fd, "       \"cache_line_size\": %zu,\n", settings->cache_line_size);
-    dprintf(fd, "       \"cache_sizes\": %s\n", cache_sizes_str);
-    dprintf(fd, "   },\n");
-    dprintf(fd, "   \"settings\": {\n");
-    dprintf(fd, "       \"concurrent\": %s,\n", settings->concurrent_run ? "true" : "false");
-    dprintf(fd, "       \"memory\": %zu,\n", settings->memory_total);
-    dprintf(fd, "       \"yield_count\": %zu,\n", settings->yield_count);
-    dprintf(fd, "       \"access_per_cache_line\": %zu,\n", settings->access_per_cache_line);
-    dprintf(fd, "       \"iterations_per_yield\": %zu\n", settings->iterations_per_yield);
-    dprintf(fd, "   },\n");
-    dprintf(fd, "   \"result\": {\n");
-    dprintf(fd, "       \"time\": %ld.%09ld,\n", results->time.tv_sec, results->time.tv_nsec);
-    dprintf(fd, "       \"time_parent\": %ld.%09ld,\n", results->time_parent.tv_sec, results->time_parent.tv_nsec);
-    dprintf(fd, "       \"time_child\": %ld.%09ld,\n", results->time_child.tv_sec, results->time_child.tv_nsec);
-    dprintf(fd, "       \"time_middle_parent\": %ld.%09ld,\n", results->time_middle_parent.tv_sec, results->time_middle_parent.tv_nsec);
-    dprintf(fd, "       \"time_middle_child\": %ld.%09ld,\n", results->time_middle_child.tv_sec, results->time_middle_child.tv_nsec);
-    dprintf(fd, "       \"vcsw_parent\": %zu,\n", results->vcsw_parent);
-    dprintf(fd, "       \"ivcsw_parent\": %zu,\n", results->ivcsw_parent);
-    dprintf(fd, "       \"vcsw_child\": %zu,\n", results->vcsw_child);
-    dprintf(fd, "       \"ivcsw_child\": %zu,\n", results->ivcsw_child);
-    dprintf(fd, "       \"minflt_parent_start\": %zu,\n", results->minflt_parent_start);
-    dprintf(fd, "       \"minflt_parent_end\": %zu,\n", results->minflt_parent_end);
-    dprintf(fd, "       \"majflt_parent_start\": %zu,\n", results->majflt_parent_start);
-    dprintf(fd, "       \"majflt_parent_end\": %zu,\n", results->majflt_parent_end);
-    dprintf(fd, "       \"minflt_child_start\": %zu,\n", results->minflt_child_start);
-    dprintf(fd, "       \"minflt_child_end\": %zu,\n", results->minflt_child_end);
-    dprintf(fd, "       \"majflt_child_start\": %zu,\n", results->majflt_child_start);
-    dprintf(fd, "       \"majflt_child_end\": %zu\n", results->majflt_child_end);
-    dprintf(fd, "   }\n");
-    dprintf(fd, "}\n");
-
-    return 0;
+    return parse_cpu_list(buf, cpu_set);
 }
 
-int main(int argc, char *argv[])
+size_t get_llc_size(size_t cpu)
 {
-    char buf[128];
-    bool is_child = false;
-
-    struct settings settings;
-    initialize_settings(&settings);
+    size_t cache_sizes[10];
+    memset(cache_sizes, 0, sizeof(cache_sizes));
+    int cache_count = get_cache_sizes(cpu, cache_sizes, sizeof(cache_sizes));
 
-    if (parse_options(&settings, argc, argv))
+    size_t llc_size = 0;
+    for (int i = 0; i < cache_count; ++i)
     {
-        exit(EXIT_FAILURE);
+        if (cache_sizes[i] > llc_size)
+        {
+            llc_size = cache_sizes[i];
+        }
     }
+    return llc_size;
+}
 
-    if (configure(&settings))
+// Returns the sum of all interrupt counts of the CPU in /proc/interrupts.
+ssize_t get_cpu_interrupts(size_t cpu)
+{
+    FILE *file = fopen("/proc/interrupts", "r");
+    if (!file)
     {
-        show_help(argv[0]);
-        exit(EXIT_FAILURE);
+        perror("fopen");
+        return -1;
     }
 
-    print_settings(&settings);
-
-    int parent_pipefds[2];
-    int child_pipefds[2];
-    if (open_pipes(parent_pipefds, child_pipefds))
+    char *line = NULL;
+    size_t line_size = 0;
+    if (getline(&line, &line_size, file) == -1)
     {
-        exit(EXIT_FAILURE);
+        perror("getline");
+        free(line);
+        fclose(file);
+        return -1;
     }
 
-    pid_t child_pid = fork();
-    if (child_pid == -1)
+    // the header names the CPU of every column
+    int column = -1;
+    int index = 0;
+    for (char *token = strtok(line, " \t\n"); token; token = strtok(NULL, " \t\n"), ++index)
     {
-        perror("fork");
-        exit(EXIT_FAILURE);
+        if ((strncmp(token, "CPU", 3) == 0) && (strtoul(token+3, NULL, 10) == cpu))
+        {
+            column = index;
+        }
     }
-
-    if (child_pid == 0)
+    if (column == -1)
     {
-        is_child = true;
+        ERROR("CPU %zu not found in /proc/interrupts\n", cpu);
+        free(line);
+        fclose(file);
+        return -1;
     }
 
-    size_t cache_line_count = settings.memory_total / settings.cache_line_size;
-    size_t **memory_blocks = malloc(cache_line_count * sizeof(size_t *));
-    for (size_t i = 0; i < cache_line_count; ++i)
+    // Only rows with a count for every CPU are added. Some rows, like ERR and MIS, have a single system-wide count.
+    int column_count = index;
+    size_t interrupts = 0;
+    while (getline(&line, &line_size, file) != -1)
     {
-        memory_blocks[i] = malloc(settings.cache_line_size);
+        char *ptr = strchr(line, ':');
+        if (!ptr)
+        {
+            continue;
+        }
+        ++ptr;
+        unsigned long column_value = 0;
+        int i = 0;
+        for (; i < column_count; ++i)
+        {
+            char *endptr;
+            unsigned long count = strtoul(ptr, &endptr, 10);
+            if (endptr == ptr)
+            {
+                break;
+            }
+            if (i == column)
+            {
+                column_value = count;
+            }
+            ptr = endptr;
+        }
+        if (i == column_count)
+        {
+            interrupts += column_value;
+        }
     }
-    mlockall(MCL_CURRENT);
 
-    if (synchronize(is_child, '1', parent_pipefds, child_pipefds))
+    free(line);
+    fclose(file);
+    return interrupts;
+}
+
+long get_runnable_tasks()
+{
+    FILE *file = fopen("/proc/stat", "r");
+    if (!file)
     {
-        exit(EXIT_FAILURE);
+        perror("fopen");
+        return -1;
     }
 
-    struct rusage rusage_self;
-    if (getrusage(RUSAGE_SELF, &rusage_self))
+    long runnable = -1;
+    char *line = NULL;
+    size_t line_size = 0;
+    while (getline(&line, &line_size, file) != -1)
     {
-        perror("getrusage");
-        exit(EXIT_FAILURE);
+        if (sscanf(line, "procs_running %ld", &runnable) == 1)
+        {
+            break;
+        }
     }
 
-    struct timespec time_start;
-    if (clock_gettime(CLOCK_MONOTONIC, &time_start))
+    free(line);
+    fclose(file);
+    return runnable;
+}
+
+bool cpu_in_sysfs_list(size_t cpu, const char *path)
+{
+    char buf[1024];
+    cpu_set_t cpu_set;
+    if ((access(path, R_OK) != 0) || (read_sysfs_str(path, buf, sizeof(buf)) <= 0) || parse_cpu_list(buf, &cpu_set))
     {
-        perror("clock_gettime");
-        exit(EXIT_FAILURE);
+        return false;
     }
+    return CPU_ISSET(cpu, &cpu_set);
+}
+
+// A hwlat style busy-loop: anything that takes the CPU away from us shows up as a gap between two clock reads.
+void measure_gaps(long duration_ns, struct audit *audit)
+{
+    struct timespec time_start;
+    struct timespec time_previous;
+    struct timespec time_now;
+    clock_gettime(CLOCK_MONOTONIC, &time_start);
+    time_previous = time_start;
 
-    for (size_t i = 0; i < settings.yield_count; ++i)
+    audit->max_gap_ns = 0;
+    audit->noise_ns = 0;
+    audit->gaps = 0;
+    do
     {
-        if (is_child && !settings.concurrent_run)
+        clock_gettime(CLOCK_MONOTONIC, &time_now);
+        long gap = timespec_to_ns(time_now) - timespec_to_ns(time_previous);
+        if (gap > AUDIT_GAP_NS)
         {
-            sched_yield();
-            continue;
+            audit->gaps++;
+            audit->noise_ns += gap;
         }
-
-        for (size_t j = 0; j < settings.iterations_per_yield; ++j)
+        if (gap > audit->max_gap_ns)
         {
-            for (size_t n = 0; n < cache_line_count; ++n)
-            {
-                for (size_t m = 0; m < settings.access_per_cache_line; ++m)
-                {
-                    // instead of modulus, use bitwise and
-                    // hope that the compiler optimizes the division into a bit shift
-                    memory_blocks[n][m&(settings.cache_line_size/sizeof(size_t)-1)]++;
-                }
-            }
+            audit->max_gap_ns = gap;
+        }
+        time_previous = time_now;
+    } while (timespec_to_ns(time_now) - timespec_to_ns(time_start) < duration_ns);
+
+    audit->duration_ns = timespec_to_ns(time_now) - timespec_to_ns(time_start);
+}
+
+int score_audit(const struct audit *audit)
+{
+    int score = 100;
+
+    if ((strlen(audit->governor) > 0) && (strcmp(audit->governor, "performance") != 0))
+    {
+        score -= 10;
+    }
+    if (audit->turbo == 1)
+    {
+        score -= 10;
+    }
+    if (!audit->isolated)
+    {
+        score -= 15;
+    }
+    if (!audit->nohz_full)
+    {
+        score -= 5;
+    }
+    // The runnable tasks are counted system-wide and say nothing about the measured CPU. Tasks that do run on it
+    // show up in the gaps.
+
+    // a 1000 Hz tick alone costs 20 points
+    int interrupt_penalty = audit->interrupt_rate / 50;
+    score -= interrupt_penalty < 20 ? interrupt_penalty : 20;
+
+    // losing 1% of the CPU to interruptions costs 30 points
+    int noise_penalty = audit->duration_ns > 0 ? 3000.0 * audit->noise_ns / audit->duration_ns : 0;
+    score -= noise_penalty < 30 ? noise_penalty : 30;
+
+    if (audit->max_gap_ns > 50 * 1000)
+    {
+        score -= 10;
+    }
+
+    return score > 0 ? score : 0;
+}
+
+int run_audit(const struct settings *settings, struct audit *audit)
+{
+    char PATH[PATH_MAX];
+    char buf[32];
+
+    memset(audit, 0, sizeof(*audit));
+
+    snprintf(PATH, sizeof(PATH), "/sys/devices/system/cpu/cpu%zu/cpufreq/scaling_governor", settings->cpu);
+    if ((access(PATH, R_OK) == 0) && (read_sysfs_str(PATH, buf, sizeof(buf)) > 0))
+    {
+        strcpy(audit->governor, buf);
+    }
+
+    audit->turbo = -1;
+    if ((access("/sys/devices/system/cpu/intel_pstate/no_turbo", R_OK) == 0) &&
+            (read_sysfs_str("/sys/devices/system/cpu/intel_pstate/no_turbo", buf, sizeof(buf)) > 0))
+    {
+        audit->turbo = atoi(buf) == 0;
+    }
+    else if ((access("/sys/devices/system/cpu/cpufreq/boost", R_OK) == 0) &&
+            (read_sysfs_str("/sys/devices/system/cpu/cpufreq/boost", buf, sizeof(buf)) > 0))
+    {
+        audit->turbo = atoi(buf) != 0;
+    }
+
+    audit->isolated = cpu_in_sysfs_list(settings->cpu, "/sys/devices/system/cpu/isolated");
+    audit->nohz_full = cpu_in_sysfs_list(settings->cpu, "/sys/devices/system/cpu/nohz_full");
+
+    // procs_running counts the whole system, including ourselves
+    long runnable = get_runnable_tasks();
+    audit->runnable = runnable > 0 ? runnable - 1 : 0;
+
+    ssize_t interrupts_start = get_cpu_interrupts(settings->cpu);
+    measure_gaps(settings->audit_duration * 1000 * 1000, audit);
+    ssize_t interrupts_end = get_cpu_interrupts(settings->cpu);
+    if ((interrupts_start >= 0) && (interrupts_end >= interrupts_start))
+    {
+        audit->interrupts = interrupts_end - interrupts_start;
+        audit->interrupt_rate = audit->interrupts * 1e9 / audit->duration_ns;
+    }
+
+    audit->score = score_audit(audit);
+
+    INFO("Audit governor: %s\n", strlen(audit->governor) > 0 ? audit->governor : "unknown");
+    INFO("Audit turbo: %s\n", audit->turbo == -1 ? "unknown" : (audit->turbo ? "enabled" : "disabled"));
+    INFO("Audit isolated: %s\n", audit->isolated ? "yes" : "no");
+    INFO("Audit nohz_full: %s\n", audit->nohz_full ? "yes" : "no");
+    INFO("Audit other runnable tasks (system-wide): %ld\n", audit->runnable);
+    INFO("Audit interrupts: %zu (%.1f/s)\n", audit->interrupts, audit->interrupt_rate);
+    INFO("Audit gaps over %d ns: %zu, %ld ns total, %ld ns max\n", AUDIT_GAP_NS, audit->gaps, audit->noise_ns,
+            audit->max_gap_ns);
+    INFO("Audit score: %d\n", audit->score);
+
+    return 0;
+}
+
+int set_affinity(int cpu)
+{
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+
+    if (sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set))
+    {
+        perror("sched_setaffinity");
+        return -1;
+    }
+
+    INFO("CPU affinity set to: %d\n", cpu);
+
+    return 0;
+}
+
+int set_fifo_scheduling(int priority)
+{
+    struct sched_param params = { .sched_priority = priority };
+
+    if (sched_setscheduler(0, SCHED_FIFO, &params))
+    {
+        perror("sched_setscheduler");
+        return -1;
+    }
+
+    INFO("Scheduling algorithm set to: SCHED_FIFO\n");
+
+    return 0;
+}
+
+// Makes a helper process die with the process that forked it, so that it cannot keep running on its CPU when the
+// measurement exits early. The parent may already be gone by the time the death signal is armed.
+void exit_with_parent(pid_t parent_pid)
+{
+    if (prctl(PR_SET_PDEATHSIG, SIGKILL) == -1)
+    {
+        perror("prctl");
+        exit(EXIT_FAILURE);
+    }
+    if (getppid() != parent_pid)
+    {
+        exit(EXIT_FAILURE);
+    }
+}
+
+void run_antagonist(const struct settings *settings, volatile size_t *passes)
+{
+    size_t line_count = settings->antagonist_footprint / settings->cache_line_size;
+    size_t words_per_line = settings->cache_line_size / sizeof(size_t);
+    size_t *memory = calloc(line_count, settings->cache_line_size);
+    if (!memory)
+    {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    if (settings->antagonist_mode == ANTAGONIST_BANDWIDTH)
+    {
+        for (;;)
+        {
+            for (size_t i = 0; i < line_count * words_per_line; ++i)
+            {
+                memory[i]++;
+            }
+            (*passes)++;
+        }
+    }
+
+    // Visit every line once per pass with a large stride that is coprime with the line count, so that the hardware
+    // prefetchers cannot hide the misses.
+    size_t stride = 4099 % line_count;
+    for (;;)
+    {
+        size_t a = stride;
+        size_t b = line_count;
+        while (b)
+        {
+            size_t t = a % b;
+            a = b;
+            b = t;
+        }
+        if (a == 1)
+        {
+            break;
+        }
+        stride++;
+    }
+
+    size_t n = 0;
+    for (;;)
+    {
+        for (size_t i = 0; i < line_count; ++i)
+        {
+            memory[n * words_per_line]++;
+            n += stride;
+            if (n >= line_count)
+            {
+                n -= line_count;
+            }
+        }
+        (*passes)++;
+    }
+}
+
+// Returns the number of antagonists started, which is short of the requested CPUs if a fork failed.
+int start_antagonists(const struct settings *settings, pid_t *pids, volatile size_t *passes)
+{
+    pid_t parent_pid = getpid();
+    int count = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (!CPU_ISSET(cpu, &settings->antagonist_cpus))
+        {
+            continue;
+        }
+
+        pid_t pid = fork();
+        if (pid == -1)
+        {
+            perror("fork");
+            return count;
+        }
+        if (pid == 0)
+        {
+            exit_with_parent(parent_pid);
+
+            // don't compete with the measured tasks for priority, only for the shared cache and memory bus
+            struct sched_param params = { .sched_priority = 0 };
+            if (sched_setscheduler(0, SCHED_OTHER, &params))
+            {
+                perror("sched_setscheduler");
+                exit(EXIT_FAILURE);
+            }
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            CPU_SET(cpu, &cpu_set);
+            if (sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set))
+            {
+                perror("sched_setaffinity");
+                exit(EXIT_FAILURE);
+            }
+            run_antagonist(settings, &passes[count]);
+        }
+
+        DEBUG("Started antagonist %d on CPU %d\n", pid, cpu);
+        pids[count++] = pid;
+    }
+
+    return count;
+}
+
+void stop_antagonists(pid_t *pids, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        kill(pids[i], SIGKILL);
+    }
+}
+
+int reap_antagonists(pid_t *pids, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        if (waitpid(pids[i], NULL, 0) == -1)
+        {
+            perror("waitpid");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static volatile unsigned long code_result;
+
+// One pass over the functions of the task, each one taking the result of the previous one.
+void call_functions(const struct memory *memory)
+{
+    unsigned long x = code_result;
+    for (size_t n = memory->code_first; n < memory->code_first + memory->code_count; ++n)
+    {
+        x = code_footprint_functions[n](x);
+    }
+    code_result = x;
+}
+
+const char *prefault_to_str(enum prefault prefault)
+{
+    switch (prefault)
+    {
+        case PREFAULT_NONE:
+            return "none";
+        case PREFAULT_TOUCH:
+            return "touch";
+        case PREFAULT_POPULATE:
+            return "populate";
+        case PREFAULT_MLOCK:
+            return "mlock";
+    }
+    return "unknown";
+}
+
+const char *backing_to_str(enum backing backing)
+{
+    switch (backing)
+    {
+        case BACKING_ANON:
+            return "anon";
+        case BACKING_SHM:
+            return "shm";
+        case BACKING_SHM_HUGETLB:
+            return "shm_hugetlb";
+        case BACKING_FILE:
+            return "file";
+    }
+    return "unknown";
+}
+
+// Reads the default huge page size from /proc/meminfo, 2 MiB if not found.
+size_t get_hugepage_size()
+{
+    size_t size = 2 * 1024 * 1024;
+    FILE *meminfo = fopen("/proc/meminfo", "r");
+    if (!meminfo)
+    {
+        return size;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), meminfo))
+    {
+        size_t kb;
+        if (sscanf(line, "Hugepagesize: %zu kB", &kb) == 1)
+        {
+            size = kb * 1024;
+            break;
+        }
+    }
+    fclose(meminfo);
+    return size;
+}
+
+// Opens what the working set of the task is mapped from, returns the descriptor, or -1 for anonymous memory, in fd.
+// A file is shared by all tasks, each mapping its own range at offset.
+int open_backing(const struct settings *settings, size_t task, size_t size, int *fd, off_t *offset)
+{
+    *fd = -1;
+    *offset = 0;
+
+    switch (settings->backing)
+    {
+        case BACKING_ANON:
+            return 0;
+        case BACKING_SHM:
+        case BACKING_SHM_HUGETLB:
+            *fd = memfd_create("cache-hotness", MFD_CLOEXEC |
+                    (settings->backing == BACKING_SHM_HUGETLB ? MFD_HUGETLB : 0));
+            if (*fd == -1)
+            {
+                perror("memfd_create");
+                return -1;
+            }
+            if (ftruncate(*fd, size))
+            {
+                perror("ftruncate");
+                close(*fd);
+                return -1;
+            }
+            return 0;
+        case BACKING_FILE:
+        {
+            *fd = open(settings->backing_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if (*fd == -1)
+            {
+                perror("open");
+                return -1;
+            }
+
+            // every task extends the file to the size needed by all, so that none of them can shrink it
+            size_t task_count = settings->coroutine_count ? settings->coroutine_count : 2;
+            *offset = task * size;
+            struct stat st;
+            if (fstat(*fd, &st) || ((st.st_size < (off_t) (task_count * size)) && ftruncate(*fd, task_count * size)))
+            {
+                perror("ftruncate");
+                close(*fd);
+                return -1;
+            }
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Lines in the arena, including the pool.
+size_t memory_lines(const struct memory *memory)
+{
+    return memory->pool_count ? memory->hot_count + memory->pool_count : memory->block_count;
+}
+
+// The working set is carved out of a single mapping, one cache line per block, so that every prefault strategy sees
+// the same layout and page faults happen only where the strategy puts them. In the code workload the working set is
+// instead the task's own share of the generated functions.
+int allocate_memory(const struct settings *settings, size_t task, struct memory *memory)
+{
+    memset(memory, 0, sizeof(*memory));
+    if (settings->workload == WORKLOAD_CODE)
+    {
+        memory->code_count = settings->code_footprint / settings->code_function_size;
+        memory->code_first = task * memory->code_count;
+        memory->code_lines = settings->code_footprint / settings->cache_line_size;
+        return 0;
+    }
+
+    // In conflict mode consecutive blocks are a whole cache way apart, so that they all index the same set.
+    size_t stride = settings->cache_line_size;
+    if (settings->conflict_level)
+    {
+        stride = settings->conflict_sets * settings->cache_line_size;
+    }
+
+    // With drift, only the hot lines are the same in every slice, the window takes the others from the pool.
+    memory->block_count = settings->memory_total / settings->cache_line_size;
+    memory->hot_count = memory->block_count * settings->reuse / 100;
+    memory->pool_count = (memory->block_count - memory->hot_count) * settings->reuse_pool;
+    if (settings->reuse == 100)
+    {
+        memory->pool_count = 0;
+    }
+    size_t line_count = memory_lines(memory);
+    memory->arena_size = line_count * stride;
+
+    // mappings of files start at page boundaries, hugetlb ones at huge page boundaries
+    size_t page_size = settings->backing == BACKING_SHM_HUGETLB ? get_hugepage_size() :
+            (size_t) sysconf(_SC_PAGESIZE);
+    memory->arena_size = (memory->arena_size + page_size - 1) / page_size * page_size;
+
+    int fd;
+    off_t offset;
+    if (open_backing(settings, task, memory->arena_size, &fd, &offset))
+    {
+        return -1;
+    }
+    int flags = settings->mapping_shared ? MAP_SHARED : MAP_PRIVATE;
+    if (fd == -1)
+    {
+        flags |= MAP_ANONYMOUS;
+    }
+    if (settings->prefault == PREFAULT_POPULATE)
+    {
+        flags |= MAP_POPULATE;
+    }
+    memory->arena = mmap(NULL, memory->arena_size, PROT_READ | PROT_WRITE, flags, fd, offset);
+    if (fd != -1)
+    {
+        close(fd);
+    }
+    if (memory->arena == MAP_FAILED)
+    {
+        perror("mmap");
+        if (settings->backing == BACKING_SHM_HUGETLB)
+        {
+            ERROR("Not enough huge pages, reserve them with /proc/sys/vm/nr_hugepages\n");
+        }
+        memory->arena = NULL;
+        return -1;
+    }
+    if (settings->madvise_hint && madvise(memory->arena, memory->arena_size, madvise_advice[settings->madvise_hint]))
+    {
+        perror("madvise");
+    }
+
+    memory->blocks = malloc(line_count * sizeof(size_t *));
+    if (!memory->blocks)
+    {
+        perror("malloc");
+        return -1;
+    }
+    for (size_t i = 0; i < line_count; ++i)
+    {
+        memory->blocks[i] = (size_t *) ((char *) memory->arena + i * stride);
+    }
+
+    return 0;
+}
+
+int prefault_memory(const struct settings *settings, struct memory *memory)
+{
+    // the text is mapped from the executable, running it once faults it in
+    if ((settings->prefault != PREFAULT_NONE) && (memory->code_count > 0))
+    {
+        call_functions(memory);
+    }
+
+    switch (settings->prefault)
+    {
+        case PREFAULT_NONE:
+        case PREFAULT_POPULATE:
+            break;
+        case PREFAULT_TOUCH:
+            for (size_t i = 0; i < memory_lines(memory); ++i)
+            {
+                memory->blocks[i][0] = 0;
+            }
+            break;
+        case PREFAULT_MLOCK:
+            if (mlockall(MCL_CURRENT | MCL_FUTURE))
+            {
+                perror("mlockall");
+                WARNING("Memory is not locked, page faults may occur in the timed region\n");
+            }
+            break;
+    }
+
+    return 0;
+}
+
+void free_memory(struct memory *memory)
+{
+    free(memory->blocks);
+    if (memory->arena)
+    {
+        munmap(memory->arena, memory->arena_size);
+    }
+}
+
+// Like access_memory(), but only the hot lines are the same in every slice. The others are a window into the pool
+// that moves on after each slice, so they are reused after reuse_pool slices.
+void access_memory_drift(const struct settings *settings, struct memory *memory)
+{
+    size_t window = memory->block_count - memory->hot_count;
+    size_t **pool = memory->blocks + memory->hot_count;
+    for (size_t j = 0; j < settings->iterations_per_yield; ++j)
+    {
+        for (size_t n = 0; n < memory->hot_count; ++n)
+        {
+            for (size_t m = 0; m < settings->access_per_cache_line; ++m)
+            {
+                memory->blocks[n][m&(settings->cache_line_size/sizeof(size_t)-1)]++;
+            }
+        }
+        size_t position = memory->pool_position;
+        for (size_t n = 0; n < window; ++n)
+        {
+            for (size_t m = 0; m < settings->access_per_cache_line; ++m)
+            {
+                pool[position][m&(settings->cache_line_size/sizeof(size_t)-1)]++;
+            }
+            if (++position == memory->pool_count)
+            {
+                position = 0;
+            }
+        }
+    }
+    memory->pool_position = (memory->pool_position + window) % memory->pool_count;
+}
+
+// The work done by a task during one scheduled slot.
+void access_memory(const struct settings *settings, struct memory *memory)
+{
+    if (memory->pool_count)
+    {
+        access_memory_drift(settings, memory);
+        return;
+    }
+
+    for (size_t j = 0; j < settings->iterations_per_yield; ++j)
+    {
+        for (size_t n = 0; n < memory->block_count; ++n)
+        {
+            for (size_t m = 0; m < settings->access_per_cache_line; ++m)
+            {
+                // instead of modulus, use bitwise and
+                // hope that the compiler optimizes the division into a bit shift
+                memory->blocks[n][m&(settings->cache_line_size/sizeof(size_t)-1)]++;
+            }
+        }
+    }
+}
+
+// The work done by a task during one scheduled slot in the code workload.
+void execute_code(const struct settings *settings, const struct memory *memory)
+{
+    for (size_t j = 0; j < settings->iterations_per_yield; ++j)
+    {
+        call_functions(memory);
+    }
+}
+
+void run_work(const struct settings *settings, struct memory *memory)
+{
+    if (settings->workload == WORKLOAD_CODE)
+    {
+        execute_code(settings, memory);
+    }
+    else
+    {
+        access_memory(settings, memory);
+    }
+}
+
+// Cache lines a task touches in one pass over its working set.
+size_t working_set_lines(const struct settings *settings, const struct memory *memory)
+{
+    return settings->workload == WORKLOAD_CODE ? memory->code_lines : memory->block_count;
+}
+
+const char *workload_to_str(enum workload workload)
+{
+    return workload == WORKLOAD_CODE ? "code" : "data";
+}
+
+bool has_syscalls(const struct settings *settings)
+{
+    for (int kind = 0; kind < SYSCALL_KIND_COUNT; ++kind)
+    {
+        if (settings->syscalls[kind])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int open_syscall_context(struct syscall_context *context)
+{
+    memset(context, 0, sizeof(*context));
+
+    char path[] = "/dev/shm/cache-hotness-XXXXXX";
+    context->file_fd = mkstemp(path);
+    if (context->file_fd == -1)
+    {
+        perror("mkstemp");
+        return -1;
+    }
+    unlink(path);
+    if (write(context->file_fd, context->buf, sizeof(context->buf)) == -1)
+    {
+        perror("write");
+        return -1;
+    }
+
+    if (pipe2(context->pipefds, O_NONBLOCK | O_CLOEXEC) == -1)
+    {
+        perror("pipe2");
+        return -1;
+    }
+
+    context->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (context->epoll_fd == -1)
+    {
+        perror("epoll_create1");
+        return -1;
+    }
+    struct epoll_event event = { .events = EPOLLIN };
+    if (epoll_ctl(context->epoll_fd, EPOLL_CTL_ADD, context->pipefds[0], &event))
+    {
+        perror("epoll_ctl");
+        return -1;
+    }
+
+    return 0;
+}
+
+void close_syscall_context(struct syscall_context *context)
+{
+    close(context->epoll_fd);
+    close(context->pipefds[0]);
+    close(context->pipefds[1]);
+    close(context->file_fd);
+}
+
+void inject_syscalls(const struct settings *settings, struct syscall_context *context)
+{
+    for (size_t i = 0; i < settings->syscalls[SYSCALL_READ]; ++i)
+    {
+        if (pread(context->file_fd, context->buf, sizeof(context->buf), 0) == -1)
+        {
+            perror("pread");
+        }
+    }
+    for (size_t i = 0; i < settings->syscalls[SYSCALL_WRITE]; ++i)
+    {
+        if ((write(context->pipefds[1], context->buf, 64) == -1) && (errno == EAGAIN))
+        {
+            context->pipe_full = true;
+        }
+    }
+    for (size_t i = 0; i < settings->syscalls[SYSCALL_GETPID]; ++i)
+    {
+        syscall(SYS_getpid);
+    }
+    for (size_t i = 0; i < settings->syscalls[SYSCALL_FUTEX]; ++i)
+    {
+        syscall(SYS_futex, &context->futex_word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+    for (size_t i = 0; i < settings->syscalls[SYSCALL_EPOLL]; ++i)
+    {
+        struct epoll_event event;
+        epoll_wait(context->epoll_fd, &event, 1, 0);
+    }
+}
+
+const char *warm_to_str(enum warm warm)
+{
+    switch (warm)
+    {
+        case WARM_NONE:
+            return "none";
+        case WARM_PREFETCH:
+            return "prefetch";
+        case WARM_TOUCH:
+            return "touch";
+    }
+    return "unknown";
+}
+
+// The n-th line touched by the next slice. With drift, the lines after the hot ones come from the window that starts
+// at pool_position and wraps around the end of the pool.
+size_t *slice_line(const struct memory *memory, size_t n)
+{
+    if (!memory->pool_count || (n < memory->hot_count))
+    {
+        return memory->blocks[n];
+    }
+    size_t position = memory->pool_position + n - memory->hot_count;
+    if (position >= memory->pool_count)
+    {
+        position -= memory->pool_count;
+    }
+    return memory->blocks[memory->hot_count + position];
+}
+
+void warm_memory(const struct settings *settings, const struct memory *memory)
+{
+    size_t count = memory->block_count;
+    if ((settings->warm_prefix > 0) && (settings->warm_prefix / settings->cache_line_size < count))
+    {
+        count = settings->warm_prefix / settings->cache_line_size;
+    }
+
+    if (settings->warm == WARM_PREFETCH)
+    {
+        for (size_t n = 0; n < count; ++n)
+        {
+            __builtin_prefetch(slice_line(memory, n), 1, 3);
+        }
+    }
+    else
+    {
+        for (size_t n = 0; n < count; ++n)
+        {
+            (void) *(volatile size_t *) slice_line(memory, n);
+        }
+    }
+}
+
+// Runs the work of one slice. With warming the warm-up pass comes first. Both are timed: the execution times also
+// hold the slices of the other tasks on the CPU, so the rates are computed from the work time alone.
+void run_slice(const struct settings *settings, struct memory *memory, long *time_warm_ns, long *time_work_ns)
+{
+    struct timespec time_warm_start;
+    struct timespec time_work_start;
+    struct timespec time_work_end;
+    if (settings->warm != WARM_NONE)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &time_warm_start);
+        warm_memory(settings, memory);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &time_work_start);
+    run_work(settings, memory);
+    clock_gettime(CLOCK_MONOTONIC, &time_work_end);
+    if (settings->warm != WARM_NONE)
+    {
+        *time_warm_ns += timespec_to_ns(time_work_start) - timespec_to_ns(time_warm_start);
+    }
+    *time_work_ns += timespec_to_ns(time_work_end) - timespec_to_ns(time_work_start);
+}
+
+void inject_syscalls_timed(const struct settings *settings, struct syscall_context *context, long *time_ns)
+{
+    struct timespec time_syscalls_start;
+    struct timespec time_syscalls_end;
+    clock_gettime(CLOCK_MONOTONIC, &time_syscalls_start);
+    inject_syscalls(settings, context);
+    clock_gettime(CLOCK_MONOTONIC, &time_syscalls_end);
+    *time_ns += timespec_to_ns(time_syscalls_end) - timespec_to_ns(time_syscalls_start);
+
+    // drain a full pipe outside of the counted syscalls and the timed slices
+    if (context->pipe_full)
+    {
+        while (read(context->pipefds[0], context->buf, sizeof(context->buf)) > 0)
+        {
+        }
+        context->pipe_full = false;
+    }
+}
+
+void telemetry_publish(struct telemetry_ring *ring, size_t slice)
+{
+    size_t head = ring->head;
+    struct telemetry_entry *entry = &ring->entries[head & (TELEMETRY_RING_SIZE-1)];
+    entry->slice = slice;
+    clock_gettime(CLOCK_MONOTONIC, &entry->time); // served by the vDSO, no syscall
+    __atomic_store_n(&ring->head, head+1, __ATOMIC_RELEASE);
+}
+
+// Writes the whole ring once, so that publishing in the timed region does not fault its pages in.
+void telemetry_prefault(struct telemetry_ring *ring)
+{
+    memset(ring->entries, 0, sizeof(ring->entries));
+    __atomic_store_n(&ring->head, 0, __ATOMIC_RELEASE);
+}
+
+// Returns the number of entries published so far and copies the latest one, if any.
+size_t telemetry_latest(struct telemetry_ring *ring, struct telemetry_entry *latest)
+{
+    for (;;)
+    {
+        size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (head == 0)
+        {
+            return 0;
+        }
+        *latest = ring->entries[(head-1) & (TELEMETRY_RING_SIZE-1)];
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        // retry if the producer lapped the ring while the entry was being copied
+        if (__atomic_load_n(&ring->head, __ATOMIC_RELAXED) - head < TELEMETRY_RING_SIZE-1)
+        {
+            return head;
+        }
+    }
+}
+
+void report_progress(FILE *out, const char *name, struct telemetry_ring *ring, size_t *last_head,
+        struct telemetry_entry *last_entry, const struct timespec *now, size_t yield_count)
+{
+    struct telemetry_entry entry;
+    size_t head = telemetry_latest(ring, &entry);
+    if (head == 0)
+    {
+        fprintf(out, "%s: waiting", name);
+        return;
+    }
+
+    double rate = 0.0;
+    if ((*last_head > 0) && (head > *last_head))
+    {
+        long time_ns = timespec_to_ns(entry.time) - timespec_to_ns(last_entry->time);
+        rate = time_ns > 0 ? (entry.slice - last_entry->slice) * 1e9 / time_ns : 0.0;
+    }
+    double idle = (timespec_to_ns(*now) - timespec_to_ns(entry.time)) / 1e9;
+
+    fprintf(out, "%s: %zu/%zu slices, %.1f slices/s, last slice %.3f s ago", name, entry.slice, yield_count, rate,
+            idle);
+
+    *last_head = head;
+    *last_entry = entry;
+}
+
+void run_reporter(const struct settings *settings, struct telemetry *telemetry)
+{
+    FILE *out = messages_to_stderr ? stderr : stdout;
+    if (strlen(settings->progress_file) > 0)
+    {
+        out = fopen(settings->progress_file, "w");
+        if (!out)
+        {
+            perror("fopen");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    size_t last_head_parent = 0;
+    size_t last_head_child = 0;
+    struct telemetry_entry last_entry_parent;
+    struct telemetry_entry last_entry_child;
+    bool finished = false;
+    while (!finished)
+    {
+        usleep(settings->progress_interval * 1000);
+        finished = __atomic_load_n(&telemetry->finished, __ATOMIC_ACQUIRE);
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        fprintf(out, "Progress: ");
+        report_progress(out, "parent", &telemetry->parent, &last_head_parent, &last_entry_parent, &now,
+                settings->yield_count);
+        fprintf(out, "; ");
+        report_progress(out, "child", &telemetry->child, &last_head_child, &last_entry_child, &now,
+                settings->yield_count);
+        fprintf(out, "\n");
+        fflush(out);
+    }
+
+    exit(EXIT_SUCCESS);
+}
+
+pid_t start_reporter(const struct settings *settings, struct telemetry *telemetry)
+{
+    pid_t parent_pid = getpid();
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        perror("fork");
+        return -1;
+    }
+    if (pid > 0)
+    {
+        DEBUG("Started progress reporter %d\n", pid);
+        return pid;
+    }
+    exit_with_parent(parent_pid);
+
+    struct sched_param params = { .sched_priority = 0 };
+    if (sched_setscheduler(0, SCHED_OTHER, &params))
+    {
+        perror("sched_setscheduler");
+        exit(EXIT_FAILURE);
+    }
+
+    // keep the reporter off the measured CPU
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu = 0; cpu < get_cpu_count(); ++cpu)
+    {
+        if ((size_t) cpu != settings->cpu)
+        {
+            CPU_SET(cpu, &cpu_set);
+        }
+    }
+    if (CPU_COUNT(&cpu_set) == 0)
+    {
+        WARNING("No CPU left for the progress reporter, progress is delayed until the measurement yields\n");
+    }
+    else if (sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set))
+    {
+        perror("sched_setaffinity");
+        exit(EXIT_FAILURE);
+    }
+
+    run_reporter(settings, telemetry);
+    return 0;
+}
+
+#if defined(__x86_64__)
+// Saves the callee-saved registers on the current stack, stores the stack pointer to *from and resumes the stack at
+// to. A switch is a handful of moves, there is no kernel entry and no signal mask to save like in swapcontext().
+void coroutine_switch(void **from, void *to);
+__asm__(
+    ".text\n"
+    ".globl coroutine_switch\n"
+    ".type coroutine_switch, @function\n"
+    "coroutine_switch:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size coroutine_switch, .-coroutine_switch\n"
+);
+
+void coroutine_context_init(struct coroutine_context *context, void *stack, size_t stack_size, void (*entry)(void))
+{
+    // Lay out the frame coroutine_switch() pops: six registers and a return address to entry. The stack pointer
+    // must be 8 modulo 16 when entry starts, as if entry had been called.
+    void **top = (void **) (((size_t) stack + stack_size) & ~(size_t) 15);
+    top[-1] = NULL;
+    top[-2] = (void *) entry;
+    void **stack_pointer = &top[-8];
+    for (int i = 0; i < 6; ++i)
+    {
+        stack_pointer[i] = NULL;
+    }
+    context->stack_pointer = stack_pointer;
+}
+
+void coroutine_context_switch(struct coroutine_context *from, struct coroutine_context *to)
+{
+    coroutine_switch(&from->stack_pointer, to->stack_pointer);
+}
+#else
+// Other architectures fall back to ucontext, which enters the kernel on every switch to save the signal mask.
+void coroutine_context_init(struct coroutine_context *context, void *stack, size_t stack_size, void (*entry)(void))
+{
+    getcontext(&context->context);
+    context->context.uc_stack.ss_sp = stack;
+    context->context.uc_stack.ss_size = stack_size;
+    context->context.uc_link = NULL;
+    makecontext(&context->context, entry, 0);
+}
+
+void coroutine_context_switch(struct coroutine_context *from, struct coroutine_context *to)
+{
+    swapcontext(&from->context, &to->context);
+}
+#endif
+
+// The entry point takes no arguments, so the running scheduler is passed through here.
+static struct coroutine_scheduler *coroutine_scheduler;
+
+// Switches to the next unfinished coroutine in round-robin order, or to the main context if all have finished.
+// Like sched_yield(), returns immediately if the caller is the only runnable task.
+void coroutine_yield(struct coroutine_scheduler *scheduler)
+{
+    size_t from = scheduler->current;
+    for (size_t k = 1; k <= scheduler->count; ++k)
+    {
+        size_t next = (from + k) % scheduler->count;
+        if (!scheduler->coroutines[next].finished)
+        {
+            if (next == from)
+            {
+                return;
+            }
+            scheduler->current = next;
+            coroutine_context_switch(&scheduler->coroutines[from].context, &scheduler->coroutines[next].context);
+            return;
+        }
+    }
+    coroutine_context_switch(&scheduler->coroutines[from].context, &scheduler->main_context);
+}
+
+// Mirrors the loops of the process based run in main(): task 0 does what the parent does, the others what the child
+// does.
+void coroutine_entry(void)
+{
+    struct coroutine_scheduler *scheduler = coroutine_scheduler;
+    const struct settings *settings = scheduler->settings;
+    size_t index = scheduler->current;
+    struct coroutine *coroutine = &scheduler->coroutines[index];
+    bool is_child = index > 0;
+    bool inject = scheduler->syscall_context != NULL;
+
+    for (size_t i = 0; i < settings->yield_count; ++i)
+    {
+        if (is_child && !settings->concurrent_run)
+        {
+            coroutine_yield(scheduler);
+            continue;
+        }
+
+        run_slice(settings, coroutine->memory, &scheduler->time_warm_ns, &scheduler->time_work_ns);
+
+        if (inject)
+        {
+            inject_syscalls_timed(settings, scheduler->syscall_context, &scheduler->time_syscalls_ns);
+        }
+
+        coroutine_yield(scheduler);
+    }
+
+    struct timespec time_middle;
+    clock_gettime(CLOCK_MONOTONIC, &time_middle);
+    coroutine->time_middle = ns_to_timespec(timespec_to_ns(time_middle) - timespec_to_ns(scheduler->time_start));
+
+    if (is_child && !settings->concurrent_run)
+    {
+        for (size_t i = 0; i < settings->yield_count; ++i)
+        {
+            run_slice(settings, coroutine->memory, &scheduler->time_warm_ns, &scheduler->time_work_ns);
+
+            if (inject)
+            {
+                inject_syscalls_timed(settings, scheduler->syscall_context, &scheduler->time_syscalls_ns);
+            }
+        }
+    }
+
+    struct timespec time_finished;
+    clock_gettime(CLOCK_MONOTONIC, &time_finished);
+    coroutine->time = ns_to_timespec(timespec_to_ns(time_finished) - timespec_to_ns(scheduler->time_start));
+
+    coroutine->finished = true;
+    coroutine_yield(scheduler);
+}
+
+int run_coroutines(const struct settings *settings, struct coroutine_results *results)
+{
+    size_t count = settings->coroutine_count;
+    struct coroutine *coroutines = calloc(count, sizeof(struct coroutine));
+    struct memory *memories = calloc(count, sizeof(struct memory));
+    if (!coroutines || !memories)
+    {
+        perror("calloc");
+        return -1;
+    }
+
+    struct rusage rusage_prefault_start;
+    if (getrusage(RUSAGE_SELF, &rusage_prefault_start))
+    {
+        perror("getrusage");
+        return -1;
+    }
+    struct timespec time_prefault_start;
+    clock_gettime(CLOCK_MONOTONIC, &time_prefault_start);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (allocate_memory(settings, i, &memories[i]) || prefault_memory(settings, &memories[i]))
+        {
+            return -1;
+        }
+        // populate the stacks so that they don't fault in the timed region
+        coroutines[i].stack = mmap(NULL, COROUTINE_STACK_SIZE, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (coroutines[i].stack == MAP_FAILED)
+        {
+            perror("mmap");
+            return -1;
+        }
+        coroutines[i].memory = &memories[i];
+        coroutine_context_init(&coroutines[i].context, coroutines[i].stack, COROUTINE_STACK_SIZE, coroutine_entry);
+    }
+
+    struct timespec time_prefault_end;
+    clock_gettime(CLOCK_MONOTONIC, &time_prefault_end);
+    struct rusage rusage_prefault_end;
+    if (getrusage(RUSAGE_SELF, &rusage_prefault_end))
+    {
+        perror("getrusage");
+        return -1;
+    }
+    results->prefault.time = ns_to_timespec(timespec_to_ns(time_prefault_end) - timespec_to_ns(time_prefault_start));
+    results->prefault.minflt = rusage_prefault_end.ru_minflt - rusage_prefault_start.ru_minflt;
+    results->prefault.majflt = rusage_prefault_end.ru_majflt - rusage_prefault_start.ru_majflt;
+
+    struct syscall_context syscall_context;
+    struct coroutine_scheduler scheduler = {
+        .settings = settings,
+        .coroutines = coroutines,
+        .count = count,
+        .current = 0,
+        .syscall_context = NULL,
+        .time_syscalls_ns = 0,
+        .time_warm_ns = 0,
+        .time_work_ns = 0,
+    };
+    if (has_syscalls(settings))
+    {
+        if (open_syscall_context(&syscall_context))
+        {
+            return -1;
+        }
+        scheduler.syscall_context = &syscall_context;
+    }
+    coroutine_scheduler = &scheduler;
+
+    struct rusage rusage_start;
+    if (getrusage(RUSAGE_SELF, &rusage_start))
+    {
+        perror("getrusage");
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &scheduler.time_start);
+
+    coroutine_context_switch(&scheduler.main_context, &coroutines[0].context);
+
+    struct rusage rusage_end;
+    if (getrusage(RUSAGE_SELF, &rusage_end))
+    {
+        perror("getrusage");
+        return -1;
+    }
+
+    results->count = count;
+    results->time = calloc(count, sizeof(struct timespec));
+    results->time_middle = calloc(count, sizeof(struct timespec));
+    long time_total_ns = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        results->time[i] = coroutines[i].time;
+        results->time_middle[i] = coroutines[i].time_middle;
+        time_total_ns += timespec_to_ns(coroutines[i].time);
+    }
+    results->time_average = ns_to_timespec(time_total_ns / count);
+    results->time_syscalls = ns_to_timespec(scheduler.time_syscalls_ns);
+    results->time_warm = ns_to_timespec(scheduler.time_warm_ns);
+    results->time_work = ns_to_timespec(scheduler.time_work_ns);
+    results->minflt_timed = rusage_end.ru_minflt - rusage_start.ru_minflt;
+    results->majflt_timed = rusage_end.ru_majflt - rusage_start.ru_majflt;
+    results->vcsw = rusage_end.ru_nvcsw - rusage_start.ru_nvcsw;
+    results->ivcsw = rusage_end.ru_nivcsw - rusage_start.ru_nivcsw;
+    size_t cache_line_count = working_set_lines(settings, &memories[0]);
+    results->accesses = cache_line_count * settings->access_per_cache_line * settings->iterations_per_yield *
+            settings->yield_count;
+    results->bytes = cache_line_count * settings->cache_line_size * settings->iterations_per_yield *
+            settings->yield_count;
+    compute_rates(results->accesses * count, results->bytes * count, results->time_work, &results->rates);
+
+    if (scheduler.syscall_context)
+    {
+        close_syscall_context(&syscall_context);
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        free_memory(&memories[i]);
+        munmap(coroutines[i].stack, COROUTINE_STACK_SIZE);
+    }
+    free(memories);
+    free(coroutines);
+
+    return 0;
+}
+
+void print_coroutine_results(const struct coroutine_results *results)
+{
+    for (size_t i = 0; i < results->count; ++i)
+    {
+        INFO("Execution time middle task %zu: %ld.%09ld s\n", i, results->time_middle[i].tv_sec,
+                results->time_middle[i].tv_nsec);
+    }
+    for (size_t i = 0; i < results->count; ++i)
+    {
+        INFO("Execution time task %zu: %ld.%09ld s\n", i, results->time[i].tv_sec, results->time[i].tv_nsec);
+    }
+    INFO("Execution time average: %ld.%09ld s\n", results->time_average.tv_sec, results->time_average.tv_nsec);
+    if (timespec_to_ns(results->time_syscalls) > 0)
+    {
+        INFO("Syscall time: %ld.%09ld s\n", results->time_syscalls.tv_sec, results->time_syscalls.tv_nsec);
+    }
+    if (timespec_to_ns(results->time_warm) > 0)
+    {
+        INFO("Warm-up time: %ld.%09ld s\n", results->time_warm.tv_sec, results->time_warm.tv_nsec);
+        INFO("Work time: %ld.%09ld s\n", results->time_work.tv_sec, results->time_work.tv_nsec);
+    }
+    INFO("Prefault time: %ld.%09ld s\n", results->prefault.time.tv_sec, results->prefault.time.tv_nsec);
+    INFO("Prefault minor page faults: %zu\n", results->prefault.minflt);
+    if (results->minflt_timed || results->majflt_timed)
+    {
+        WARNING("Page faults occurred in the timed region, results include the page fault path\n");
+        WARNING("Page faults in timed region: %zu minor, %zu major\n", results->minflt_timed, results->majflt_timed);
+    }
+    INFO("Voluntary context switches: %zu\n", results->vcsw);
+    INFO("Involuntary context switches: %zu\n", results->ivcsw);
+
+    INFO("Memory accesses per task: %zu\n", results->accesses);
+    print_rates("average", &results->rates);
+}
+
+int open_pipes(int parent_pipefds[], int child_pipefds[])
+{
+    if (pipe(parent_pipefds) == -1)
+    {
+        perror("pipe");
+        return -1;
+    }
+
+    if (pipe(child_pipefds) == -1)
+    {
+        perror("pipe");
+        return -1;
+    }
+
+    return 0;
+}
+
+int synchronize(bool is_child, char phase, int parent_pipefds[], int child_pipefds[])
+{
+    int write_fd = is_child ? child_pipefds[1] : parent_pipefds[1];
+    int read_fd = is_child ? parent_pipefds[0] : child_pipefds[0];
+
+    if (write(write_fd, &phase, 1) == -1)
+    {
+        perror("write");
+        return -1;
+    }
+
+    char buf;
+    if (read(read_fd, &buf, 1) == -1)
+    {
+        perror("read");
+        return -1;
+    }
+
+    if (buf != phase)
+    {
+        ERROR("ERROR: in synchronize(), expected %c but got %c\n", phase, buf);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Audits every campaign CPU in turn while pinned to it, and keeps its score for the campaign lines.
+int audit_campaign_cpus(struct settings *settings)
+{
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (!CPU_ISSET(cpu, &settings->campaign_cpus))
+        {
+            continue;
+        }
+        struct settings cpu_settings = *settings;
+        cpu_settings.cpu = cpu;
+        INFO("Audit of campaign CPU %d\n", cpu);
+        if (set_affinity(cpu) || run_audit(&cpu_settings, &cpu_settings.audit))
+        {
+            return -1;
+        }
+        int score = cpu_settings.audit.score;
+        settings->campaign_audit_scores[cpu] = score;
+        if (score < settings->audit_threshold)
+        {
+            if (settings->audit_mode == AUDIT_REFUSE)
+            {
+                ERROR("Audit score %d of CPU %d is below the threshold %d, refusing to run\n", score, cpu,
+                        settings->audit_threshold);
+                return -1;
+            }
+            WARNING("Audit score %d of CPU %d is below the threshold %d, results may be noisy\n", score, cpu,
+                    settings->audit_threshold);
+        }
+    }
+
+    return set_affinity(settings->cpu);
+}
+
+void initialize_settings(struct settings *settings)
+{
+    settings->cache_line_size = get_cache_line_size();
+    settings->memory_total = 0;     // 4 MiB unless conflict mode sizes it
+    settings->access_per_cache_line = 1;
+    settings->iterations_per_yield = 1;
+
+    settings->reuse = 100;
+    settings->reuse_pool = 8;
+
+    settings->workload = WORKLOAD_DATA;
+    settings->code_footprint = 64 * 1024; // 64 KiB
+    settings->code_function_size = 0;
+    settings->icache_size = 0;
+
+    settings->yield_count = 16;
+    settings->prefault = PREFAULT_MLOCK;
+
+    settings->backing = BACKING_ANON;
+    strcpy(settings->backing_path, "");
+    settings->mapping_shared = false;
+    settings->madvise_hint = 0;
+
+    settings->conflict_level = 0;
+    settings->conflict_lines = 0;
+    settings->conflict_sets = 0;
+    settings->conflict_ways = 0;
+
+    memset(settings->syscalls, 0, sizeof(settings->syscalls));
+
+    settings->coroutine_count = 0;
+
+    settings->warm = WARM_NONE;
+    settings->warm_prefix = 0;
+
+    settings->until_stable = 0.0;
+    settings->time_budget = 300.0;
+
+    memset(settings->fit_iterations, 0, sizeof(settings->fit_iterations));
+    settings->fit_points = 0;
+
+    settings->audit_mode = AUDIT_OFF;
+    settings->audit_duration = 1000;
+    settings->audit_threshold = 70;
+    memset(&settings->audit, 0, sizeof(settings->audit));
+
+    settings->concurrent_run = true;
+    settings->fifo_priority = 1;
+
+    settings->cpu = get_cpu_count() - 1;
+    settings->cpu_freq_start = -1;
+    settings->cpu_freq_finish = -1;
+
+    settings->freq_source = FREQ_NONE;
+    settings->freq_slices = false;
+    settings->freq_tolerance = 0.05;
+
+    CPU_ZERO(&settings->antagonist_cpus);
+    settings->antagonist_mode = ANTAGONIST_LLC;
+    settings->antagonist_footprint = 0;
+
+    settings->progress_interval = 0;
+    strcpy(settings->progress_file, "");
+
+    CPU_ZERO(&settings->campaign_cpus);
+    memset(settings->campaign_memory, 0, sizeof(settings->campaign_memory));
+    settings->campaign_points = 0;
+    memset(settings->campaign_reuse, 0, sizeof(settings->campaign_reuse));
+    settings->campaign_reuse_count = 0;
+    settings->campaign_separate_llc = false;
+    memset(settings->campaign_audit_scores, 0, sizeof(settings->campaign_audit_scores));
+
+    strcpy(settings->outfile, "");
+}
+
+int configure(struct settings *settings)
+{
+    char buf[128];
+
+    if (set_affinity(settings->cpu))
+    {
+        return -1;
+    }
+
+    settings->cpu_freq_start = get_cpu_freq_cpuinfo(settings);
+    if (settings->cpu_freq_start == -1)
+    {
+        return -1;
+    }
+    if (settings->cpu_freq_start)
+    {
+        if (cpu_freq_to_str(settings->cpu_freq_start, buf, sizeof(buf)))
+        {
+            return -1;
+        }
+        INFO("CPU freq: %s\n", buf);
+    }
+
+    struct freq_counter freq_counter;
+    if (freq_counter_open(&freq_counter, FREQ_NONE, settings->cpu) == 0)
+    {
+        settings->freq_source = freq_counter.source;
+        freq_counter_close(&freq_counter);
+        INFO("Effective frequency source: %s\n", freq_source_to_str(settings->freq_source));
+    }
+    else
+    {
+        WARNING("Effective frequency not available, neither perf cycles nor APERF/MPERF are readable\n");
+    }
+
+    if (settings->conflict_level && settings->memory_total)
+    {
+        ERROR("memory_total cannot be set in conflict mode, use conflict_lines to size the working set\n");
+        return -1;
+    }
+    if (settings->memory_total == 0)
+    {
+        settings->memory_total = 4 * 1024 * 1024; // 4 MiB
+    }
+
+    if (settings->conflict_level)
+    {
+        struct cache_info cache_info;
+        if (get_cache_info(settings->cpu, settings->conflict_level, false, &cache_info))
+        {
+            ERROR("No level %d data cache found for CPU %zu\n", settings->conflict_level, settings->cpu);
+            return -1;
+        }
+        settings->conflict_sets = cache_info.sets;
+        settings->conflict_ways = cache_info.ways;
+        if (settings->conflict_lines == 0)
+        {
+            settings->conflict_lines = cache_info.ways;
+        }
+        settings->memory_total = settings->conflict_lines * settings->cache_line_size;
+
+        // Only the L1 is reliably indexed by virtual address. Beyond a page the set is picked by the physical
+        // address, which matches the virtual one only while the whole stride lies within one huge page.
+        size_t stride = settings->conflict_sets * settings->cache_line_size;
+        if (stride > (size_t) sysconf(_SC_PAGESIZE))
+        {
+            if (settings->backing != BACKING_SHM_HUGETLB)
+            {
+                ERROR("Conflict stride of %zu bytes exceeds the page size, level %d needs --backing=shm_hugetlb\n",
+                        stride, settings->conflict_level);
+                return -1;
+            }
+            if (stride > get_hugepage_size())
+            {
+                ERROR("Conflict stride of %zu bytes exceeds the huge page size, the lines cannot be kept in one set\n",
+                        stride);
+                return -1;
+            }
+        }
+    }
+
+    if (((settings->reuse < 100) || settings->campaign_reuse_count) &&
+            (settings->conflict_level || (settings->workload == WORKLOAD_CODE)))
+    {
+        ERROR("reuse is not available in conflict mode or with the code workload\n");
+        return -1;
+    }
+
+    if (settings->workload == WORKLOAD_CODE)
+    {
+        if (settings->conflict_level || (settings->warm != WARM_NONE) || (settings->backing != BACKING_ANON))
+        {
+            ERROR("Conflict mode, warm-up and backing are only available with the data workload\n");
+            return -1;
+        }
+        // every function is called once per pass, whatever its number of cache lines
+        if (settings->access_per_cache_line != 1)
+        {
+            ERROR("access_per_cache_line is only available with the data workload\n");
+            return -1;
+        }
+
+        struct cache_info cache_info;
+        if (get_cache_info(settings->cpu, 1, true, &cache_info) == 0)
+        {
+            settings->icache_size = cache_info.size;
+        }
+        else
+        {
+            WARNING("L1I size not available\n");
+        }
+
+        size_t code_size = __stop_code_footprint - __start_code_footprint;
+        settings->code_function_size = code_size / code_footprint_function_count;
+        size_t functions = settings->code_footprint / settings->code_function_size;
+        if (functions == 0)
+        {
+            functions = 1;
+        }
+        size_t tasks = settings->coroutine_count ? settings->coroutine_count : 2;
+        if (functions * tasks > code_footprint_function_count)
+        {
+            human_readable_size(code_size / tasks, buf, sizeof(buf));
+            ERROR("Code footprint is limited to %s per task\n", buf);
+            return -1;
+        }
+        settings->code_footprint = functions * settings->code_function_size;
+    }
+
+    if (settings->fit_points)
+    {
+        if (settings->coroutine_count || (settings->until_stable > 0.0))
+        {
+            ERROR("fit_refill is not available with coroutines or until_stable\n");
+            return -1;
+        }
+        // without interleaving there are no switches between the tasks to refill after
+        if (!settings->concurrent_run)
+        {
+            ERROR("fit_refill needs concurrent=yes\n");
+            return -1;
+        }
+        bool distinct = false;
+        for (size_t i = 1; i < settings->fit_points; ++i)
+        {
+            distinct |= settings->fit_iterations[i] != settings->fit_iterations[0];
+        }
+        if (!distinct)
+        {
+            ERROR("fit_refill needs at least two different iterations\n");
+            return -1;
+        }
+    }
+
+    if (CPU_COUNT(&settings->campaign_cpus) > 0)
+    {
+        if (settings->coroutine_count || (settings->until_stable > 0.0) || settings->fit_points)
+        {
+            ERROR("campaign is not available with coroutines, until_stable or fit_refill\n");
+            return -1;
+        }
+        if (settings->conflict_level || (settings->workload == WORKLOAD_CODE))
+        {
+            ERROR("campaign sweeps memory_total, it is not available in conflict mode or with the code workload\n");
+            return -1;
+        }
+        if (settings->campaign_points == 0)
+        {
+            ERROR("campaign needs the memory sizes to measure, see --campaign_memory\n");
+            return -1;
+        }
+        if ((CPU_COUNT(&settings->antagonist_cpus) > 0) || (settings->progress_interval > 0))
+        {
+            WARNING("Antagonists and progress reporting are not available in a campaign\n");
+            CPU_ZERO(&settings->antagonist_cpus);
+            settings->progress_interval = 0;
+        }
+
+        if (settings->campaign_separate_llc)
+        {
+            // keep the lowest CPU of every LLC
+            cpu_set_t covered;
+            CPU_ZERO(&covered);
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (!CPU_ISSET(cpu, &settings->campaign_cpus))
+                {
+                    continue;
+                }
+                if (CPU_ISSET(cpu, &covered))
+                {
+                    CPU_CLR(cpu, &settings->campaign_cpus);
+                    continue;
+                }
+                cpu_set_t llc_cpus;
+                if (get_llc_cpus(cpu, &llc_cpus))
+                {
+                    ERROR("LLC of CPU %d not available\n", cpu);
+                    return -1;
+                }
+                CPU_OR(&covered, &covered, &llc_cpus);
+            }
+        }
+
+        // the frequency source was picked on the CPU given with --cpu, the points run on the campaign CPUs
+        for (int cpu = 0; (cpu < CPU_SETSIZE) && (settings->freq_source != FREQ_NONE); ++cpu)
+        {
+            struct freq_counter cpu_counter;
+            if (!CPU_ISSET(cpu, &settings->campaign_cpus))
+            {
+                continue;
+            }
+            if (freq_counter_open(&cpu_counter, settings->freq_source, cpu))
+            {
+                WARNING("Effective frequency not available on campaign CPU %d\n", cpu);
+                continue;
+            }
+            freq_counter_close(&cpu_counter);
+        }
+    }
+    else if (settings->campaign_points || settings->campaign_reuse_count || settings->campaign_separate_llc)
+    {
+        ERROR("campaign_memory, campaign_reuse and campaign_separate_llc need --campaign_cpus\n");
+        return -1;
+    }
+
+    if (settings->coroutine_count && (settings->until_stable > 0.0))
+    {
+        ERROR("until_stable is not available with coroutines\n");
+        return -1;
+    }
+
+    if (settings->coroutine_count)
+    {
+        if ((CPU_COUNT(&settings->antagonist_cpus) > 0) || (settings->progress_interval > 0))
+        {
+            WARNING("Antagonists and progress reporting are not available with coroutines\n");
+            CPU_ZERO(&settings->antagonist_cpus);
+            settings->progress_interval = 0;
+        }
+    }
+
+    if (CPU_COUNT(&settings->antagonist_cpus) > 0)
+    {
+        if (CPU_ISSET(settings->cpu, &settings->antagonist_cpus))
+        {
+            ERROR("Antagonist CPUs must not include the measured CPU %zu\n", settings->cpu);
+            return -1;
+        }
+        if (settings->antagonist_footprint == 0)
+        {
+            size_t llc_size = get_llc_size(settings->cpu);
+            if (llc_size == 0)
+            {
+                WARNING("LLC size not available, using 32 MB antagonist footprint\n");
+                llc_size = 16 * 1024 * 1024;
+            }
+            settings->antagonist_footprint = 2 * llc_size;
+        }
+        if (settings->antagonist_footprint < settings->cache_line_size)
+        {
+            ERROR("Antagonist footprint must be at least one cache line\n");
+            return -1;
+        }
+    }
+
+    if (set_fifo_scheduling(settings->fifo_priority))
+    {
+        return -1;
+    }
+
+    // audit with the same affinity and scheduling as the measurement
+    if ((settings->audit_mode != AUDIT_OFF) && (CPU_COUNT(&settings->campaign_cpus) > 0))
+    {
+        if (audit_campaign_cpus(settings))
+        {
+            return -1;
+        }
+    }
+    else if (settings->audit_mode != AUDIT_OFF)
+    {
+        if (run_audit(settings, &settings->audit))
+        {
+            return -1;
+        }
+        if (settings->audit.score < settings->audit_threshold)
+        {
+            if (settings->audit_mode == AUDIT_REFUSE)
+            {
+                ERROR("Audit score %d is below the threshold %d, refusing to run\n", settings->audit.score,
+                        settings->audit_threshold);
+                return -1;
+            }
+            WARNING("Audit score %d is below the threshold %d, results may be noisy\n", settings->audit.score,
+                    settings->audit_threshold);
+        }
+    }
+
+    return 0;
+}
+
+// Bytes a task touches between two accesses to the same hot or pool line. In a concurrent run the lines of the other
+// task come on top.
+void reuse_distances(const struct settings *settings, size_t *distance_hot, size_t *distance_pool)
+{
+    size_t block_count = settings->memory_total / settings->cache_line_size;
+    size_t hot_count = block_count * settings->reuse / 100;
+    size_t pool_count = (block_count - hot_count) * settings->reuse_pool;
+
+    // a hot line is touched once per pass, a pool line once every reuse_pool slices
+    *distance_hot = block_count * settings->cache_line_size;
+    *distance_pool = settings->reuse < 100 ? (hot_count + pool_count) * settings->cache_line_size : *distance_hot;
+}
+
+size_t campaign_point_count(const struct settings *settings)
+{
+    return settings->campaign_points * (settings->campaign_reuse_count ? settings->campaign_reuse_count : 1);
+}
+
+void print_settings(const struct settings *settings)
+{
+    char buf[128];
+    INFO("Concurrent run: %s\n", settings->concurrent_run ? "yes" : "no");
+    if (settings->coroutine_count)
+    {
+        INFO("Coroutines: %zu\n", settings->coroutine_count);
+    }
+    INFO("Cache line size: %zu\n", settings->cache_line_size);
+    char cache_sizes_str[100];
+    get_cache_sizes_str(cache_sizes_str, sizeof(cache_sizes_str), settings->cpu, true);
+    INFO("Cache sizes: %s\n", cache_sizes_str);
+    if (settings->workload == WORKLOAD_CODE)
+    {
+        INFO("Workload: code\n");
+        if (settings->icache_size)
+        {
+            human_readable_size(settings->icache_size, buf, sizeof(buf));
+            INFO("L1I size: %s\n", buf);
+        }
+        human_readable_size(settings->code_footprint, buf, sizeof(buf));
+        INFO("Code footprint: %s, %zu functions\n", buf, settings->code_footprint / settings->code_function_size);
+    }
+    else
+    {
+        human_readable_size(settings->memory_total, buf, sizeof(buf));
+        INFO("Memory total: %s\n", buf);
+    }
+    INFO("Accesses per cache line: %zu\n", settings->access_per_cache_line);
+    INFO("Iterations per yield: %zu\n", settings->iterations_per_yield);
+    INFO("Yield count: %zu\n", settings->yield_count);
+    INFO("Prefault: %s\n", prefault_to_str(settings->prefault));
+    INFO("Backing: %s%s%s, %s mapping\n", backing_to_str(settings->backing), settings->backing == BACKING_FILE ? " " : "",
+            settings->backing_path, settings->mapping_shared ? "shared" : "private");
+    if (settings->madvise_hint)
+    {
+        INFO("madvise: %s\n", madvise_names[settings->madvise_hint]);
+    }
+    if (settings->reuse < 100)
+    {
+        size_t distance_hot;
+        size_t distance_pool;
+        reuse_distances(settings, &distance_hot, &distance_pool);
+        INFO("Reuse: %zu%%, pool of %zu windows\n", settings->reuse, settings->reuse_pool);
+        human_readable_size(distance_hot, buf, sizeof(buf));
+        INFO("Reuse distance of hot lines: %s\n", buf);
+        human_readable_size(distance_pool, buf, sizeof(buf));
+        INFO("Reuse distance of pool lines: %s, %zu slices\n", buf, settings->reuse_pool);
+    }
+    if (settings->warm != WARM_NONE)
+    {
+        INFO("Warm-up: %s\n", warm_to_str(settings->warm));
+        if (settings->warm_prefix > 0)
+        {
+            human_readable_size(settings->warm_prefix, buf, sizeof(buf));
+            INFO("Warm-up prefix: %s\n", buf);
+        }
+    }
+    if (settings->until_stable > 0.0)
+    {
+        INFO("Until stable: %.3f relative error, %.0f s budget\n", settings->until_stable, settings->time_budget);
+    }
+    if (settings->fit_points)
+    {
+        INFO("Refill fit points: %zu\n", settings->fit_points);
+    }
+    if (CPU_COUNT(&settings->campaign_cpus) > 0)
+    {
+        cpu_set_to_str(&settings->campaign_cpus, buf, sizeof(buf));
+        INFO("Campaign CPUs: %s%s\n", buf, settings->campaign_separate_llc ? ", separate LLCs" : "");
+        INFO("Campaign points: %zu\n", campaign_point_count(settings));
+    }
+    if (has_syscalls(settings))
+    {
+        syscall_mix_to_str(settings->syscalls, buf, sizeof(buf), false);
+        INFO("Syscalls per yield: %s\n", buf);
+    }
+    if (settings->conflict_level)
+    {
+        // in a concurrent run both tasks compete for the same set
+        size_t set_footprint = settings->conflict_lines * (settings->concurrent_run ? 2 : 1);
+        INFO("Conflict cache level: L%d, %zu sets, %zu ways\n", settings->conflict_level, settings->conflict_sets,
+                settings->conflict_ways);
+        INFO("Conflict lines per task: %zu\n", settings->conflict_lines);
+        INFO("Conflict set footprint: %zu lines, %s associativity\n", set_footprint,
+                set_footprint > settings->conflict_ways ? "exceeds" : "within");
+    }
+    if (CPU_COUNT(&settings->antagonist_cpus) > 0)
+    {
+        cpu_set_to_str(&settings->antagonist_cpus, buf, sizeof(buf));
+        INFO("Antagonist CPUs: %s\n", buf);
+        INFO("Antagonist mode: %s\n", settings->antagonist_mode == ANTAGONIST_LLC ? "llc" : "bandwidth");
+        human_readable_size(settings->antagonist_footprint, buf, sizeof(buf));
+        INFO("Antagonist footprint: %s\n", buf);
+    }
+}
+
+// Writes str as the contents of a JSON string, escaping quotes, backslashes and control characters.
+void write_json_escaped(int fd, const char *str)
+{
+    for (const char *c = str; *c; ++c)
+    {
+        if ((*c == '"') || (*c == '\\'))
+        {
+            dprintf(fd, "\\%c", *c);
+        }
+        else if ((unsigned char) *c < 0x20)
+        {
+            dprintf(fd, "\\u%04x", *c);
+        }
+        else
+        {
+            dprintf(fd, "%c", *c);
+        }
+    }
+}
+
+// Writes the opening brace and all sections that describe the environment and settings of the run.
+int write_settings_json(int fd, const struct settings *settings)
+{
+    char cache_sizes_str[100];
+    get_cache_sizes_str(cache_sizes_str, sizeof(cache_sizes_str), settings->cpu, false);
+
+    char syscalls_str[256];
+    if (syscall_mix_to_str(settings->syscalls, syscalls_str, sizeof(syscalls_str), true))
+    {
+        return -1;
+    }
+
+    size_t distance_hot;
+    size_t distance_pool;
+    reuse_distances(settings, &distance_hot, &distance_pool);
+
+    char hostname[HOST_NAME_MAX];
+    if (gethostname(hostname, HOST_NAME_MAX))
+    {
+        perror("gethostname");
+        return -1;
+    }
+    
+
+    dprintf(fd, "{\n");
+    dprintf(fd, "   \"general\": {\n");
+    dprintf(fd, "       \"version\": \"%s\",\n", PACKAGE_VERSION);
+    dprintf(fd, "       \"hostname\": \"%s\",\n", hostname);
+    dprintf(fd, "       \"algorithm\": \"SCHED_FIFO\",\n");
+    dprintf(fd, "       \"tasks\": \"%s\"\n", settings->coroutine_count ? "coroutines" : "processes");
+    dprintf(fd, "   },\n");
+    dprintf(fd, "   \"cpu\": {\n");
+    dprintf(fd, "       \"id\": %zu,\n", settings->cpu);
+    dprintf(fd, "       \"cpu_freq_start\": %zu,\n", settings->cpu_freq_start);
+    dprintf(fd, "       \"cpu_freq_finish\": %zu,\n", settings->cpu_freq_finish);
+    dprintf(fd, "       \"freq_source\": \"%s\",\n", freq_source_to_str(settings->freq_source));
+    dprintf(fd, "       \"cache_line_size\": %zu,\n", settings->cache_line_size);
+    dprintf(fd, "       \"cache_sizes\": %s,\n", cache_sizes_str);
+    dprintf(fd, "       \"l1i_size\": %zu\n", settings->icache_size);
+    dprintf(fd, "   },\n");
+    dprintf(fd, "   \"settings\": {\n");
+    dprintf(fd, "       \"concurrent\": %s,\n", settings->concurrent_run ? "true" : "false");
+    dprintf(fd, "       \"workload\": \"%s\",\n", workload_to_str(settings->workload));
+    dprintf(fd, "       \"memory\": %zu,\n", settings->memory_total);
+    dprintf(fd, "       \"code_footprint\": %zu,\n", settings->workload == WORKLOAD_CODE ? settings->code_footprint : 0);
+    dprintf(fd, "       \"yield_count\": %zu,\n", settings->yield_count);
+    dprintf(fd, "       \"access_per_cache_line\": %zu,\n", settings->access_per_cache_line);
+    dprintf(fd, "       \"iterations_per_yield\": %zu,\n", settings->iterations_per_yield);
+    dprintf(fd, "       \"prefault\": \"%s\",\n", prefault_to_str(settings->prefault));
+    dprintf(fd, "       \"backing\": \"%s\",\n", backing_to_str(settings->backing));
+    dprintf(fd, "       \"backing_path\": \"");
+    write_json_escaped(fd, settings->backing_path);
+    dprintf(fd, "\",\n");
+    dprintf(fd, "       \"mapping\": \"%s\",\n", settings->mapping_shared ? "shared" : "private");
+    dprintf(fd, "       \"madvise\": \"%s\",\n", madvise_names[settings->madvise_hint]);
+    dprintf(fd, "       \"syscalls\": { %s },\n", syscalls_str);
+    dprintf(fd, "       \"coroutines\": %zu,\n", settings->coroutine_count);
+    dprintf(fd, "       \"warm\": \"%s\",\n", warm_to_str(settings->warm));
+    dprintf(fd, "       \"warm_prefix\": %zu,\n", settings->warm_prefix);
+    dprintf(fd, "       \"reuse\": %zu,\n", settings->reuse);
+    dprintf(fd, "       \"reuse_pool\": %zu,\n", settings->reuse_pool);
+    dprintf(fd, "       \"reuse_distance_hot\": %zu,\n", distance_hot);
+    dprintf(fd, "       \"reuse_distance_pool\": %zu\n", distance_pool);
+    dprintf(fd, "   },\n");
+    size_t set_footprint = settings->conflict_lines * (settings->concurrent_run ? 2 : 1);
+    dprintf(fd, "   \"conflict\": {\n");
+    dprintf(fd, "       \"level\": %d,\n", settings->conflict_level);
+    dprintf(fd, "       \"sets\": %zu,\n", settings->conflict_sets);
+    dprintf(fd, "       \"ways\": %zu,\n", settings->conflict_ways);
+    dprintf(fd, "       \"lines_per_task\": %zu,\n", settings->conflict_lines);
+    dprintf(fd, "       \"set_footprint\": %zu,\n", set_footprint);
+    dprintf(fd, "       \"exceeds_associativity\": %s\n",
+            (settings->conflict_level && set_footprint > settings->conflict_ways) ? "true" : "false");
+    dprintf(fd, "   },\n");
+    const struct audit *audit = &settings->audit;
+    dprintf(fd, "   \"audit\": {\n");
+    dprintf(fd, "       \"enabled\": %s,\n", settings->audit_mode != AUDIT_OFF ? "true" : "false");
+    dprintf(fd, "       \"governor\": \"%s\",\n", audit->governor);
+    dprintf(fd, "       \"turbo\": %d,\n", audit->turbo);
+    dprintf(fd, "       \"isolated\": %s,\n", audit->isolated ? "true" : "false");
+    dprintf(fd, "       \"nohz_full\": %s,\n", audit->nohz_full ? "true" : "false");
+    dprintf(fd, "       \"runnable_system\": %ld,\n", audit->runnable);
+    dprintf(fd, "       \"interrupts\": %zu,\n", audit->interrupts);
+    dprintf(fd, "       \"interrupt_rate\": %.3f,\n", audit->interrupt_rate);
+    dprintf(fd, "       \"duration\": %ld,\n", audit->duration_ns);
+    dprintf(fd, "       \"gaps\": %zu,\n", audit->gaps);
+    dprintf(fd, "       \"noise\": %ld,\n", audit->noise_ns);
+    dprintf(fd, "       \"max_gap\": %ld,\n", audit->max_gap_ns);
+    dprintf(fd, "       \"score\": %d\n", audit->score);
+    dprintf(fd, "   },\n");
+
+    return 0;
+}
+
+int open_outfile(const struct settings *settings)
+{
+    int fd = open(settings->outfile, O_WRONLY | O_CLOEXEC | O_CREAT | O_EXCL, 0644);
+    if (fd == -1)
+    {
+        perror("open");
+    }
+    return fd;
+}
+
+int write_file_coroutines(const struct settings *settings, const struct coroutine_results *results)
+{
+    int fd = open_outfile(settings);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    if (write_settings_json(fd, settings))
+    {
+        return -1;
+    }
+
+    dprintf(fd, "   \"result\": {\n");
+    dprintf(fd, "       \"time\": %ld.%09ld,\n", results->time_average.tv_sec, results->time_average.tv_nsec);
+    dprintf(fd, "       \"time_tasks\": [");
+    for (size_t i = 0; i < results->count; ++i)
+    {
+        dprintf(fd, "%s%ld.%09ld", i ? ", " : "", results->time[i].tv_sec, results->time[i].tv_nsec);
+    }
+    dprintf(fd, "],\n");
+    dprintf(fd, "       \"time_middle_tasks\": [");
+    for (size_t i = 0; i < results->count; ++i)
+    {
+        dprintf(fd, "%s%ld.%09ld", i ? ", " : "", results->time_middle[i].tv_sec, results->time_middle[i].tv_nsec);
+    }
+    dprintf(fd, "],\n");
+    dprintf(fd, "       \"vcsw\": %zu,\n", results->vcsw);
+    dprintf(fd, "       \"ivcsw\": %zu,\n", results->ivcsw);
+    dprintf(fd, "       \"time_prefault\": %ld.%09ld,\n", results->prefault.time.tv_sec, results->prefault.time.tv_nsec);
+    dprintf(fd, "       \"minflt_prefault\": %zu,\n", results->prefault.minflt);
+    dprintf(fd, "       \"majflt_prefault\": %zu,\n", results->prefault.majflt);
+    dprintf(fd, "       \"minflt_timed\": %zu,\n", results->minflt_timed);
+    dprintf(fd, "       \"majflt_timed\": %zu,\n", results->majflt_timed);
+    dprintf(fd, "       \"time_syscalls\": %ld.%09ld,\n", results->time_syscalls.tv_sec, results->time_syscalls.tv_nsec);
+    dprintf(fd, "       \"time_warm\": %ld.%09ld,\n", results->time_warm.tv_sec, results->time_warm.tv_nsec);
+    dprintf(fd, "       \"time_work\": %ld.%09ld\n", results->time_work.tv_sec, results->time_work.tv_nsec);
+    dprintf(fd, "   },\n");
+    dprintf(fd, "   \"rates\": {\n");
+    dprintf(fd, "       \"time\": \"work\",\n");
+    dprintf(fd, "       \"accesses\": %zu,\n", results->accesses);
+    dprintf(fd, "       \"bytes\": %zu,\n", results->bytes);
+    dprintf(fd, "       \"access_rate\": %.0f,\n", results->rates.access_rate);
+    dprintf(fd, "       \"bandwidth\": %.6f,\n", results->rates.bandwidth);
+    dprintf(fd, "       \"ns_per_access\": %.6f\n", results->rates.ns_per_access);
+    dprintf(fd, "   }\n");
+    dprintf(fd, "}\n");
+
+    return 0;
+}
+
+int write_file(const struct settings *settings, const struct results *results)
+{
+    int fd = open_outfile(settings);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    if (write_settings_json(fd, settings))
+    {
+        return -1;
+    }
+
+    char antagonist_cpus_str[1024];
+    if (cpu_set_to_str(&settings->antagonist_cpus, antagonist_cpus_str, sizeof(antagonist_cpus_str)))
+    {
+        return -1;
+    }
+
+    dprintf(fd, "   \"antagonists\": {\n");
+    dprintf(fd, "       \"cpus\": %s,\n", antagonist_cpus_str);
+    dprintf(fd, "       \"mode\": \"%s\",\n", settings->antagonist_mode == ANTAGONIST_LLC ? "llc" : "bandwidth");
+    dprintf(fd, "       \"footprint\": %zu,\n", settings->antagonist_footprint);
+    dprintf(fd, "       \"passes\": %zu,\n", results->antagonist_passes);
+    dprintf(fd, "       \"bandwidth\": %.6f\n", results->antagonist_bandwidth);
+    dprintf(fd, "   },\n");
+    dprintf(fd, "   \"result\": {\n");
+    dprintf(fd, "       \"time\": %ld.%09ld,\n", results->time.tv_sec, results->time.tv_nsec);
+    dprintf(fd, "       \"time_parent\": %ld.%09ld,\n", results->time_parent.tv_sec, results->time_parent.tv_nsec);
+    dprintf(fd, "       \"time_child\": %ld.%09ld,\n", results->time_child.tv_sec, results->time_child.tv_nsec);
+    dprintf(fd, "       \"time_middle_parent\": %ld.%09ld,\n", results->time_middle_parent.tv_sec, results->time_middle_parent.tv_nsec);
+    dprintf(fd, "       \"time_middle_child\": %ld.%09ld,\n", results->time_middle_child.tv_sec, results->time_middle_child.tv_nsec);
+    dprintf(fd, "       \"vcsw_parent\": %zu,\n", results->vcsw_parent);
+    dprintf(fd, "       \"ivcsw_parent\": %zu,\n", results->ivcsw_parent);
+    dprintf(fd, "       \"vcsw_child\": %zu,\n", results->vcsw_child);
+    dprintf(fd, "       \"ivcsw_child\": %zu,\n", results->ivcsw_child);
+    dprintf(fd, "       \"minflt_parent_start\": %zu,\n", results->minflt_parent_start);
+    dprintf(fd, "       \"minflt_parent_end\": %zu,\n", results->minflt_parent_end);
+    dprintf(fd, "       \"majflt_parent_start\": %zu,\n", results->majflt_parent_start);
+    dprintf(fd, "       \"majflt_parent_end\": %zu,\n", results->majflt_parent_end);
+    dprintf(fd, "       \"minflt_child_start\": %zu,\n", results->minflt_child_start);
+    dprintf(fd, "       \"minflt_child_end\": %zu,\n", results->minflt_child_end);
+    dprintf(fd, "       \"majflt_child_start\": %zu,\n", results->majflt_child_start);
+    dprintf(fd, "       \"majflt_child_end\": %zu,\n", results->majflt_child_end);
+    dprintf(fd, "       \"time_prefault_parent\": %ld.%09ld,\n", results->prefault_parent.time.tv_sec, results->prefault_parent.time.tv_nsec);
+    dprintf(fd, "       \"time_prefault_child\": %ld.%09ld,\n", results->prefault_child.time.tv_sec, results->prefault_child.time.tv_nsec);
+    dprintf(fd, "       \"minflt_prefault_parent\": %zu,\n", results->prefault_parent.minflt);
+    dprintf(fd, "       \"majflt_prefault_parent\": %zu,\n", results->prefault_parent.majflt);
+    dprintf(fd, "       \"minflt_prefault_child\": %zu,\n", results->prefault_child.minflt);
+    dprintf(fd, "       \"majflt_prefault_child\": %zu,\n", results->prefault_child.majflt);
+    dprintf(fd, "       \"minflt_timed_parent\": %zu,\n", results->minflt_timed_parent);
+    dprintf(fd, "       \"majflt_timed_parent\": %zu,\n", results->majflt_timed_parent);
+    dprintf(fd, "       \"minflt_timed_child\": %zu,\n", results->minflt_timed_child);
+    dprintf(fd, "       \"majflt_timed_child\": %zu,\n", results->majflt_timed_child);
+    dprintf(fd, "       \"time_syscalls_parent\": %ld.%09ld,\n", results->time_syscalls_parent.tv_sec, results->time_syscalls_parent.tv_nsec);
+    dprintf(fd, "       \"time_syscalls_child\": %ld.%09ld,\n", results->time_syscalls_child.tv_sec, results->time_syscalls_child.tv_nsec);
+    dprintf(fd, "       \"time_warm_parent\": %ld.%09ld,\n", results->time_warm_parent.tv_sec, results->time_warm_parent.tv_nsec);
+    dprintf(fd, "       \"time_warm_child\": %ld.%09ld,\n", results->time_warm_child.tv_sec, results->time_warm_child.tv_nsec);
+    dprintf(fd, "       \"time_work_parent\": %ld.%09ld,\n", results->time_work_parent.tv_sec, results->time_work_parent.tv_nsec);
+    dprintf(fd, "       \"time_work_child\": %ld.%09ld\n", results->time_work_child.tv_sec, results->time_work_child.tv_nsec);
+    dprintf(fd, "   },\n");
+    dprintf(fd, "   \"rates\": {\n");
+    dprintf(fd, "       \"time\": \"work\",\n");
+    dprintf(fd, "       \"accesses\": %zu,\n", results->accesses);
+    dprintf(fd, "       \"bytes\": %zu,\n", results->bytes);
+    dprintf(fd, "       \"access_rate_parent\": %.0f,\n", results->rates_parent.access_rate);
+    dprintf(fd, "       \"access_rate_child\": %.0f,\n", results->rates_child.access_rate);
+    dprintf(fd, "       \"access_rate_middle_parent\": %.0f,\n", results->rates_middle_parent.access_rate);
+    dprintf(fd, "       \"access_rate_middle_child\": %.0f,\n", results->rates_middle_child.access_rate);
+    dprintf(fd, "       \"bandwidth_parent\": %.6f,\n", results->rates_parent.bandwidth);
+    dprintf(fd, "       \"bandwidth_child\": %.6f,\n", results->rates_child.bandwidth);
+    dprintf(fd, "       \"bandwidth_middle_parent\": %.6f,\n", results->rates_middle_parent.bandwidth);
+    dprintf(fd, "       \"bandwidth_middle_child\": %.6f,\n", results->rates_middle_child.bandwidth);
+    dprintf(fd, "       \"ns_per_access_parent\": %.6f,\n", results->rates_parent.ns_per_access);
+    dprintf(fd, "       \"ns_per_access_child\": %.6f,\n", results->rates_child.ns_per_access);
+    dprintf(fd, "       \"ns_per_access_middle_parent\": %.6f,\n", results->rates_middle_parent.ns_per_access);
+    dprintf(fd, "       \"ns_per_access_middle_child\": %.6f\n", results->rates_middle_child.ns_per_access);
+    dprintf(fd, "   },\n");
+    dprintf(fd, "   \"frequency\": {\n");
+    dprintf(fd, "       \"source\": \"%s\",\n", freq_source_to_str(settings->freq_source));
+    dprintf(fd, "       \"tolerance\": %.6f,\n", settings->freq_tolerance);
+    dprintf(fd, "       \"variation\": %.6f,\n", results->freq_variation);
+    dprintf(fd, "       \"stable\": %s,\n", results->freq_stable ? "true" : "false");
+    dprintf(fd, "       \"user_only\": %s,\n",
+            (results->freq_parent.user_only || results->freq_child.user_only) ? "true" : "false");
+    dprintf(fd, "       \"ghz_parent\": %.6f,\n", results->freq_parent.total.ghz);
+    dprintf(fd, "       \"ghz_child\": %.6f,\n", results->freq_child.total.ghz);
+    dprintf(fd, "       \"ghz_middle_parent\": %.6f,\n", results->freq_parent.middle.ghz);
+    dprintf(fd, "       \"ghz_middle_child\": %.6f,\n", results->freq_child.middle.ghz);
+    dprintf(fd, "       \"ratio_parent\": %.6f,\n", results->freq_parent.total.ratio);
+    dprintf(fd, "       \"ratio_child\": %.6f,\n", results->freq_child.total.ratio);
+    dprintf(fd, "       \"slice_ghz_min_parent\": %.6f,\n", results->freq_parent.slice_ghz_min);
+    dprintf(fd, "       \"slice_ghz_max_parent\": %.6f,\n", results->freq_parent.slice_ghz_max);
+    dprintf(fd, "       \"slice_ghz_min_child\": %.6f,\n", results->freq_child.slice_ghz_min);
+    dprintf(fd, "       \"slice_ghz_max_child\": %.6f,\n", results->freq_child.slice_ghz_max);
+    dprintf(fd, "       \"slice_ratio_min_parent\": %.6f,\n", results->freq_parent.slice_ratio_min);
+    dprintf(fd, "       \"slice_ratio_max_parent\": %.6f,\n", results->freq_parent.slice_ratio_max);
+    dprintf(fd, "       \"slice_ratio_min_child\": %.6f,\n", results->freq_child.slice_ratio_min);
+    dprintf(fd, "       \"slice_ratio_max_child\": %.6f,\n", results->freq_child.slice_ratio_max);
+    dprintf(fd, "       \"cycles_parent\": %.0f,\n", results->cycles_parent);
+    dprintf(fd, "       \"cycles_child\": %.0f,\n", results->cycles_child);
+    dprintf(fd, "       \"cycles_middle_parent\": %.0f,\n", results->cycles_middle_parent);
+    dprintf(fd, "       \"cycles_middle_child\": %.0f\n", results->cycles_middle_child);
+    dprintf(fd, "   },\n");
+    dprintf(fd, "   \"stability\": {\n");
+    dprintf(fd, "       \"target\": %.6f,\n", settings->until_stable);
+    dprintf(fd, "       \"trials\": %zu,\n", results->stability.trials);
+    dprintf(fd, "       \"discarded\": %zu,\n", results->stability.discarded);
+    dprintf(fd, "       \"converged\": %s,\n", results->stability.converged ? "true" : "false");
+    dprintf(fd, "       \"penalty\": %.9f,\n", results->stability.penalty);
+    dprintf(fd, "       \"penalty_ci\": %.9f,\n", results->stability.penalty_ci);
+    dprintf(fd, "       \"relative_error\": %.6f,\n", results->stability.relative_error);
+    dprintf(fd, "       \"time_concurrent\": %.9f,\n", results->stability.time_concurrent);
+    dprintf(fd, "       \"time_sequential\": %.9f,\n", results->stability.time_sequential);
+    dprintf(fd, "       \"elapsed\": %.3f\n", results->stability.elapsed);
+    dprintf(fd, "   },\n");
+    const struct refill_fit *fit = &results->fit;
+    dprintf(fd, "   \"refill_fit\": {\n");
+    dprintf(fd, "       \"points\": [");
+    for (size_t i = 0; i < fit->points; ++i)
+    {
+        dprintf(fd, "%s\n           { \"iterations\": %zu, \"time_per_slice\": %.12f }", i ? "," : "",
+                fit->iterations[i], fit->time_per_slice[i]);
+    }
+    dprintf(fd, "%s],\n", fit->points ? "\n       " : "");
+    dprintf(fd, "       \"switch_cost\": %.12f,\n", fit->switch_cost);
+    dprintf(fd, "       \"intercept\": %.12f,\n", fit->intercept);
+    dprintf(fd, "       \"refill_cost\": %.12f,\n", fit->refill_cost);
+    dprintf(fd, "       \"pass_cost\": %.12f,\n", fit->pass_cost);
+    dprintf(fd, "       \"r_squared\": %.6f\n", fit->r_squared);
+    dprintf(fd, "   }\n");
+    dprintf(fd, "}\n");
+
+    return 0;
+}
+
+// The relative spread of the effective frequency over both tasks, their phases and slices. In a sequential run the
+// child only yields during the middle phase, so that phase is left out.
+// Compares the ratios to the reference cycles rather than GHz, as they are exact even when the counters are limited
+// to user space.
+double freq_variation(const struct settings *settings, const struct results *results)
+{
+    double values[] = {
+        results->freq_parent.total.ratio,
+        results->freq_child.total.ratio,
+        results->freq_parent.middle.ratio,
+        settings->concurrent_run ? results->freq_child.middle.ratio : 0.0,
+        results->freq_parent.slice_ratio_min,
+        results->freq_parent.slice_ratio_max,
+        results->freq_child.slice_ratio_min,
+        results->freq_child.slice_ratio_max,
+    };
+
+    double lowest = 0.0;
+    double highest = 0.0;
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i)
+    {
+        if (values[i] <= 0.0)
+        {
+            continue;
+        }
+        if ((lowest == 0.0) || (values[i] < lowest))
+        {
+            lowest = values[i];
+        }
+        if (values[i] > highest)
+        {
+            highest = values[i];
+        }
+    }
+    return lowest > 0.0 ? (highest - lowest) / lowest : 0.0;
+}
+
+void print_freq(const char *name, const struct freq_results *freq, double cycles)
+{
+    INFO("Effective frequency %s: %.3f GHz, %.3f of nominal, middle phase %.3f GHz\n", name, freq->total.ghz,
+            freq->total.ratio, freq->middle.ghz);
+    if (freq->slice_ghz_max > 0.0)
+    {
+        INFO("Slice frequency %s: %.3f - %.3f GHz\n", name, freq->slice_ghz_min, freq->slice_ghz_max);
+    }
+    INFO("Execution cycles %s: %.0f\n", name, cycles);
+}
+
+// Runs the parent and the child once next to the helpers. Only the parent returns, the child exits once it has sent
+// its results. Right after the timed region the antagonists are killed and the reporter is told to finish, both are
+// reaped by the caller.
+int run_tasks(const struct settings *settings, struct helpers *helpers, struct results *results)
+{
+    char buf[128];
+    bool is_child = false;
+
+    int parent_pipefds[2];
+    int child_pipefds[2];
+    if (open_pipes(parent_pipefds, child_pipefds))
+    {
+        return -1;
+    }
+
+    struct telemetry *telemetry = helpers->telemetry;
+    fflush(stdout);
+    pid_t child_pid = fork();
+    if (child_pid == -1)
+    {
+        perror("fork");
+        return -1;
+    }
+
+    if (child_pid == 0)
+    {
+        is_child = true;
+    }
+
+    struct telemetry_ring *telemetry_ring = NULL;
+    if (telemetry)
+    {
+        telemetry_ring = is_child ? &telemetry->child : &telemetry->parent;
+    }
+
+    struct rusage rusage_prefault_start;
+    if (getrusage(RUSAGE_SELF, &rusage_prefault_start))
+    {
+        perror("getrusage");
+        return -1;
+    }
+    struct timespec time_prefault_start;
+    if (clock_gettime(CLOCK_MONOTONIC, &time_prefault_start))
+    {
+        perror("clock_gettime");
+        return -1;
+    }
+
+    struct memory memory;
+    if (allocate_memory(settings, is_child ? 1 : 0, &memory) || prefault_memory(settings, &memory))
+    {
+        return -1;
+    }
+    size_t cache_line_count = working_set_lines(settings, &memory);
+    if (telemetry_ring)
+    {
+        telemetry_prefault(telemetry_ring);
+    }
+
+    struct timespec time_prefault_end;
+    if (clock_gettime(CLOCK_MONOTONIC, &time_prefault_end))
+    {
+        perror("clock_gettime");
+        return -1;
+    }
+    struct rusage rusage_prefault_end;
+    if (getrusage(RUSAGE_SELF, &rusage_prefault_end))
+    {
+        perror("getrusage");
+        return -1;
+    }
+    long time_prefault_ns = timespec_to_ns(time_prefault_end) - timespec_to_ns(time_prefault_start);
+    struct prefault_results prefault = {
+        .time = {
+            .tv_sec = time_prefault_ns / (1000 * 1000 * 1000),
+            .tv_nsec = time_prefault_ns % (1000 * 1000 * 1000)
+        },
+        .minflt = rusage_prefault_end.ru_minflt - rusage_prefault_start.ru_minflt,
+        .majflt = rusage_prefault_end.ru_majflt - rusage_prefault_start.ru_majflt,
+    };
+
+    bool inject = has_syscalls(settings);
+    struct syscall_context syscall_context;
+    if (inject && open_syscall_context(&syscall_context))
+    {
+        return -1;
+    }
+    long time_syscalls_ns = 0;
+    long time_warm_ns = 0;
+    long time_work_ns = 0;
+
+    struct freq_counter freq_counter = {
+        .source = FREQ_NONE,
+        .cycles_fd = -1,
+        .ref_cycles_fd = -1,
+    };
+    if ((settings->freq_source != FREQ_NONE) && freq_counter_open(&freq_counter, settings->freq_source, settings->cpu))
+    {
+        WARNING("Effective frequency not available in the %s\n", is_child ? "child" : "parent");
+    }
+    struct freq_results freq;
+    memset(&freq, 0, sizeof(freq));
+    struct freq_sample freq_start;
+    struct freq_sample freq_middle;
+    struct freq_sample freq_finished;
+    struct freq_sample freq_slice;
+    memset(&freq_start, 0, sizeof(freq_start));
+    memset(&freq_middle, 0, sizeof(freq_middle));
+    memset(&freq_finished, 0, sizeof(freq_finished));
+    bool freq_failed = false;  // a failed read leaves the frequency of this task unavailable
+
+    if (synchronize(is_child, '1', parent_pipefds, child_pipefds))
+    {
+        return -1;
+    }
+
+    struct rusage rusage_self;
+    if (getrusage(RUSAGE_SELF, &rusage_self))
+    {
+        perror("getrusage");
+        return -1;
+    }
+
+    if (freq_counter_read(&freq_counter, &freq_start))
+    {
+        freq_failed = true;
+    }
+    struct timespec time_start;
+    if (clock_gettime(CLOCK_MONOTONIC, &time_start))
+    {
+        perror("clock_gettime");
+        return -1;
+    }
+
+    for (size_t i = 0; i < settings->yield_count; ++i)
+    {
+        if (is_child && !settings->concurrent_run)
+        {
+            sched_yield();
+            continue;
+        }
+
+        bool slice_sampled = false;
+        if (settings->freq_slices && !freq_failed)
+        {
+            slice_sampled = freq_counter_read(&freq_counter, &freq_slice) == 0;
+            freq_failed = !slice_sampled;
+        }
+        run_slice(settings, &memory, &time_warm_ns, &time_work_ns);
+        if (slice_sampled && track_slice_freq(&freq_counter, &freq_slice, &freq))
+        {
+            freq_failed = true;
+        }
+
+        if (telemetry_ring)
+        {
+            telemetry_publish(telemetry_ring, i+1);
+        }
+
+        if (inject)
+        {
+            inject_syscalls_timed(settings, &syscall_context, &time_syscalls_ns);
         }
 
         sched_yield();
     }
 
-    struct timespec time_middle;
-    if (clock_gettime(CLOCK_MONOTONIC, &time_middle))
+    struct timespec time_middle;
+    if (clock_gettime(CLOCK_MONOTONIC, &time_middle))
+    {
+        perror("clock_gettime");
+        return -1;
+    }
+    long time_work_middle_ns = time_work_ns;
+    if (freq_counter_read(&freq_counter, &freq_middle))
+    {
+        freq_failed = true;
+    }
+    long time_diff_middle_ns = time_middle.tv_nsec - time_start.tv_nsec +
+                        (time_middle.tv_sec - time_start.tv_sec) * 1000 * 1000 * 1000;
+    struct timespec time_diff_middle = {
+            .tv_sec = time_diff_middle_ns / (1000 * 1000 * 1000),
+            .tv_nsec = time_diff_middle_ns % (1000 * 1000 * 1000)
+    };
+
+    if (is_child && !settings->concurrent_run)
+    {
+        for (size_t i = 0; i < settings->yield_count; ++i)
+        {
+            bool slice_sampled = false;
+            if (settings->freq_slices && !freq_failed)
+            {
+                slice_sampled = freq_counter_read(&freq_counter, &freq_slice) == 0;
+                freq_failed = !slice_sampled;
+            }
+            run_slice(settings, &memory, &time_warm_ns, &time_work_ns);
+            if (slice_sampled && track_slice_freq(&freq_counter, &freq_slice, &freq))
+            {
+                freq_failed = true;
+            }
+
+            if (telemetry_ring)
+            {
+                telemetry_publish(telemetry_ring, i+1);
+            }
+
+            if (inject)
+            {
+                inject_syscalls_timed(settings, &syscall_context, &time_syscalls_ns);
+            }
+        }
+    }
+
+    struct timespec time_finished;
+    if (clock_gettime(CLOCK_MONOTONIC, &time_finished))
+    {
+        perror("clock_gettime");
+        return -1;
+    }
+    if (freq_counter_read(&freq_counter, &freq_finished))
+    {
+        freq_failed = true;
+    }
+    compute_freq_phase(&freq_counter, &freq_start, &freq_middle, &freq.middle);
+    compute_freq_phase(&freq_counter, &freq_start, &freq_finished, &freq.total);
+    freq.user_only = freq_counter.user_only;
+    freq_counter_close(&freq_counter);
+
+    struct rusage rusage_timed_end;
+    if (getrusage(RUSAGE_SELF, &rusage_timed_end))
+    {
+        perror("getrusage");
+        return -1;
+    }
+
+    // zero frequencies are left out of the variation and the cycles, like without a counter
+    if (freq_failed)
+    {
+        WARNING("Reading the frequency counters failed in the %s, its effective frequency is not available\n",
+                is_child ? "child" : "parent");
+        memset(&freq, 0, sizeof(freq));
+    }
+
+    free_memory(&memory);
+    if (inject)
+    {
+        close_syscall_context(&syscall_context);
+    }
+
+    long time_diff_ns = time_finished.tv_nsec - time_start.tv_nsec +
+                        (time_finished.tv_sec - time_start.tv_sec) * 1000 * 1000 * 1000;
+    struct timespec time_diff = {
+            .tv_sec = time_diff_ns / (1000 * 1000 * 1000),
+            .tv_nsec = time_diff_ns % (1000 * 1000 * 1000)
+    };
+
+    if (is_child)
+    {
+        if (write(child_pipefds[1], &rusage_self, sizeof(rusage_self)) == -1)
+        {
+            perror("write");
+            return -1;
+        }
+        if (write(child_pipefds[1], &time_diff_middle, sizeof(time_diff_middle)) == -1)
+        {
+            perror("write");
+            return -1;
+        }
+        if (write(child_pipefds[1], &time_diff, sizeof(time_diff)) == -1)
+        {
+            perror("write");
+            return -1;
+        }
+        if (write(child_pipefds[1], &prefault, sizeof(prefault)) == -1)
+        {
+            perror("write");
+            return -1;
+        }
+        if (write(child_pipefds[1], &rusage_timed_end, sizeof(rusage_timed_end)) == -1)
+        {
+            perror("write");
+            return -1;
+        }
+        if (write(child_pipefds[1], &time_syscalls_ns, sizeof(time_syscalls_ns)) == -1)
+        {
+            perror("write");
+            return -1;
+        }
+        if (write(child_pipefds[1], &time_warm_ns, sizeof(time_warm_ns)) == -1)
+        {
+            perror("write");
+            return -1;
+        }
+        if (write(child_pipefds[1], &time_work_ns, sizeof(time_work_ns)) == -1)
+        {
+            perror("write");
+            return -1;
+        }
+        if (write(child_pipefds[1], &time_work_middle_ns, sizeof(time_work_middle_ns)) == -1)
+        {
+            perror("write");
+            return -1;
+        }
+        if (write(child_pipefds[1], &freq, sizeof(freq)) == -1)
+        {
+            perror("write");
+            return -1;
+        }
+        exit(EXIT_SUCCESS);
+    }
+
+    struct rusage rusage_child_start;
+    struct timespec time_diff_middle_child;
+    struct timespec time_diff_child;
+    if (read(child_pipefds[0], &rusage_child_start, sizeof(rusage_child_start)) == -1)
+    {
+        perror("read");
+        return -1;
+    }
+    if (read(child_pipefds[0], &time_diff_middle_child, sizeof(time_diff_middle_child)) == -1)
+    {
+        perror("read");
+        return -1;
+    }
+    if (read(child_pipefds[0], &time_diff_child, sizeof(time_diff_child)) == -1)
+    {
+        perror("read");
+        return -1;
+    }
+    struct prefault_results prefault_child;
+    struct rusage rusage_timed_end_child;
+    if (read(child_pipefds[0], &prefault_child, sizeof(prefault_child)) == -1)
+    {
+        perror("read");
+        return -1;
+    }
+    if (read(child_pipefds[0], &rusage_timed_end_child, sizeof(rusage_timed_end_child)) == -1)
+    {
+        perror("read");
+        return -1;
+    }
+    long time_syscalls_child_ns;
+    if (read(child_pipefds[0], &time_syscalls_child_ns, sizeof(time_syscalls_child_ns)) == -1)
+    {
+        perror("read");
+        return -1;
+    }
+    long time_warm_child_ns;
+    long time_work_child_ns;
+    if (read(child_pipefds[0], &time_warm_child_ns, sizeof(time_warm_child_ns)) == -1)
+    {
+        perror("read");
+        return -1;
+    }
+    if (read(child_pipefds[0], &time_work_child_ns, sizeof(time_work_child_ns)) == -1)
+    {
+        perror("read");
+        return -1;
+    }
+    long time_work_middle_child_ns;
+    if (read(child_pipefds[0], &time_work_middle_child_ns, sizeof(time_work_middle_child_ns)) == -1)
+    {
+        perror("read");
+        return -1;
+    }
+    struct freq_results freq_child;
+    if (read(child_pipefds[0], &freq_child, sizeof(freq_child)) == -1)
+    {
+        perror("read");
+        return -1;
+    }
+
+    if (telemetry)
+    {
+        __atomic_store_n(&telemetry->finished, 1, __ATOMIC_RELEASE);
+    }
+
+    size_t antagonist_passes_total = 0;
+    double antagonist_bandwidth = 0.0;
+    if (helpers->antagonist_count > 0)
+    {
+        struct timespec time_antagonists_stop;
+        if (clock_gettime(CLOCK_MONOTONIC, &time_antagonists_stop))
+        {
+            perror("clock_gettime");
+            return -1;
+        }
+        // stop the antagonists right after the timed region, they are reaped once the child has been waited for
+        stop_antagonists(helpers->antagonist_pids, helpers->antagonist_count);
+        for (int i = 0; i < helpers->antagonist_count; ++i)
+        {
+            antagonist_passes_total += helpers->antagonist_passes[i];
+        }
+        long antagonist_time_ns = timespec_to_ns(time_antagonists_stop) - timespec_to_ns(helpers->time_antagonists_start);
+        antagonist_bandwidth = (double) antagonist_passes_total * settings->antagonist_footprint / antagonist_time_ns;
+        INFO("Antagonist passes: %zu\n", antagonist_passes_total);
+        INFO("Antagonist bandwidth: %.3f GB/s\n", antagonist_bandwidth);
+    }
+
+    INFO("Execution time middle parent: %ld.%09ld s\n", time_diff_middle.tv_sec, time_diff_middle.tv_nsec);
+    INFO("Execution time middle child: %ld.%09ld s\n", time_diff_middle_child.tv_sec, time_diff_middle_child.tv_nsec);
+    INFO("Execution time parent: %ld.%09ld s\n", time_diff.tv_sec, time_diff.tv_nsec);
+    INFO("Execution time child: %ld.%09ld s\n", time_diff_child.tv_sec, time_diff_child.tv_nsec);
+
+    long time_diff_average_ns = ((time_diff.tv_sec + time_diff_child.tv_sec) * 1000 * 1000 * 1000 +
+                                time_diff.tv_nsec + time_diff_child.tv_nsec) / 2;
+    struct timespec time_diff_average = {
+            .tv_sec = time_diff_average_ns / (1000 * 1000 * 1000),
+            .tv_nsec = time_diff_average_ns % (1000 * 1000 * 1000)
+    };
+
+    INFO("Execution time average: %ld.%09ld s\n", time_diff_average.tv_sec, time_diff_average.tv_nsec);
+
+    struct timespec time_syscalls = {
+            .tv_sec = time_syscalls_ns / (1000 * 1000 * 1000),
+            .tv_nsec = time_syscalls_ns % (1000 * 1000 * 1000)
+    };
+    struct timespec time_syscalls_child = {
+            .tv_sec = time_syscalls_child_ns / (1000 * 1000 * 1000),
+            .tv_nsec = time_syscalls_child_ns % (1000 * 1000 * 1000)
+    };
+    if (inject)
+    {
+        // The execution times also hold the slices and the syscalls of the other task, so the time outside of the
+        // syscalls is summed over the timed slices instead. It still contains the refills caused by the kernel's cache
+        // footprint. Compare it against a run without syscalls to get the extra refill penalty.
+        long time_nonsyscall_ns = time_warm_ns + time_work_ns;
+        long time_nonsyscall_child_ns = time_warm_child_ns + time_work_child_ns;
+        INFO("Syscall time parent: %ld.%09ld s\n", time_syscalls.tv_sec, time_syscalls.tv_nsec);
+        INFO("Syscall time child: %ld.%09ld s\n", time_syscalls_child.tv_sec, time_syscalls_child.tv_nsec);
+        INFO("Execution time parent excluding syscalls: %ld.%09ld s\n", time_nonsyscall_ns / (1000 * 1000 * 1000),
+                time_nonsyscall_ns % (1000 * 1000 * 1000));
+        INFO("Execution time child excluding syscalls: %ld.%09ld s\n", time_nonsyscall_child_ns / (1000 * 1000 * 1000),
+                time_nonsyscall_child_ns % (1000 * 1000 * 1000));
+    }
+
+    if (settings->warm != WARM_NONE)
+    {
+        INFO("Warm-up time parent: %ld.%09ld s\n", time_warm_ns / (1000 * 1000 * 1000), time_warm_ns % (1000 * 1000 * 1000));
+        INFO("Warm-up time child: %ld.%09ld s\n", time_warm_child_ns / (1000 * 1000 * 1000),
+                time_warm_child_ns % (1000 * 1000 * 1000));
+        INFO("Work time parent: %ld.%09ld s\n", time_work_ns / (1000 * 1000 * 1000), time_work_ns % (1000 * 1000 * 1000));
+        INFO("Work time child: %ld.%09ld s\n", time_work_child_ns / (1000 * 1000 * 1000),
+                time_work_child_ns % (1000 * 1000 * 1000));
+    }
+
+    INFO("Prefault time parent: %ld.%09ld s\n", prefault.time.tv_sec, prefault.time.tv_nsec);
+    INFO("Prefault time child: %ld.%09ld s\n", prefault_child.time.tv_sec, prefault_child.time.tv_nsec);
+    INFO("Prefault minor page faults parent: %zu\n", prefault.minflt);
+    INFO("Prefault minor page faults child: %zu\n", prefault_child.minflt);
+
+    size_t minflt_timed_parent = rusage_timed_end.ru_minflt - rusage_self.ru_minflt;
+    size_t majflt_timed_parent = rusage_timed_end.ru_majflt - rusage_self.ru_majflt;
+    size_t minflt_timed_child = rusage_timed_end_child.ru_minflt - rusage_child_start.ru_minflt;
+    size_t majflt_timed_child = rusage_timed_end_child.ru_majflt - rusage_child_start.ru_majflt;
+    if (minflt_timed_parent || majflt_timed_parent || minflt_timed_child || majflt_timed_child)
+    {
+        WARNING("Page faults occurred in the timed region, results include the page fault path\n");
+        WARNING("Parent page faults in timed region: %zu minor, %zu major\n", minflt_timed_parent, majflt_timed_parent);
+        WARNING("Child page faults in timed region: %zu minor, %zu major\n", minflt_timed_child, majflt_timed_child);
+    }
+
+    // wait4() gives the resource usage of this child alone, RUSAGE_CHILDREN would add up all earlier runs
+    struct rusage rusage_child;
+    if (wait4(child_pid, NULL, 0, &rusage_child) == -1)
+    {
+        perror("wait4");
+        return -1;
+    }
+
+    struct rusage rusage_parent;
+    if (getrusage(RUSAGE_SELF, &rusage_parent))
+    {
+        perror("getrusage");
+        return -1;
+    }
+
+
+    INFO("Parent minor page faults diff: %zu\n", rusage_parent.ru_minflt - rusage_self.ru_minflt);
+    INFO("Parent major page faults diff: %zu\n", rusage_parent.ru_majflt - rusage_self.ru_majflt);
+    INFO("Child minor page faults diff: %zu\n", rusage_child.ru_minflt - rusage_child_start.ru_minflt);
+    INFO("Child major page faults diff: %zu\n", rusage_child.ru_majflt - rusage_child_start.ru_majflt);
+
+    INFO("Parent voluntary context switches: %zu\n", rusage_parent.ru_nvcsw);
+    INFO("Parent involuntary context switches: %zu\n", rusage_parent.ru_nivcsw);
+    INFO("Child voluntary context switches: %zu\n", rusage_child.ru_nvcsw);
+    INFO("Child involuntary context switches: %zu\n", rusage_child.ru_nivcsw);
+
+    *results = (struct results) {
+        .time = time_diff_average,
+        .time_parent = time_diff,
+        .time_child = time_diff_child,
+        .time_middle_parent = time_diff_middle,
+        .time_middle_child = time_diff_middle_child,
+        .vcsw_parent = rusage_parent.ru_nvcsw,
+        .ivcsw_parent = rusage_parent.ru_nivcsw,
+        .vcsw_child = rusage_child.ru_nvcsw,
+        .ivcsw_child = rusage_child.ru_nivcsw,
+        .minflt_parent_start = rusage_self.ru_minflt,
+        .minflt_parent_end = rusage_parent.ru_minflt,
+        .majflt_parent_start = rusage_self.ru_majflt,
+        .majflt_parent_end = rusage_parent.ru_majflt,
+        .minflt_child_start = rusage_child_start.ru_minflt,
+        .minflt_child_end = rusage_child.ru_minflt,
+        .majflt_child_start = rusage_child_start.ru_majflt,
+        .majflt_child_end = rusage_child.ru_majflt,
+        .prefault_parent = prefault,
+        .prefault_child = prefault_child,
+        .minflt_timed_parent = minflt_timed_parent,
+        .majflt_timed_parent = majflt_timed_parent,
+        .minflt_timed_child = minflt_timed_child,
+        .majflt_timed_child = majflt_timed_child,
+        .time_syscalls_parent = time_syscalls,
+        .time_syscalls_child = time_syscalls_child,
+        .time_warm_parent = ns_to_timespec(time_warm_ns),
+        .time_warm_child = ns_to_timespec(time_warm_child_ns),
+        .time_work_parent = ns_to_timespec(time_work_ns),
+        .time_work_child = ns_to_timespec(time_work_child_ns),
+        .freq_parent = freq,
+        .freq_child = freq_child,
+        .antagonist_passes = antagonist_passes_total,
+        .antagonist_bandwidth = antagonist_bandwidth,
+    };
+
+    // In cycles at the effective frequency, execution times don't depend on the frequency the CPU happened to run at.
+    results->cycles_parent = timespec_to_ns(results->time_parent) * freq.total.ghz;
+    results->cycles_child = timespec_to_ns(results->time_child) * freq_child.total.ghz;
+    results->cycles_middle_parent = timespec_to_ns(results->time_middle_parent) * freq.middle.ghz;
+    results->cycles_middle_child = timespec_to_ns(results->time_middle_child) * freq_child.middle.ghz;
+    results->freq_variation = freq_variation(settings, results);
+    results->freq_stable = results->freq_variation <= settings->freq_tolerance;
+    if (settings->freq_source != FREQ_NONE)
+    {
+        print_freq("parent", &freq, results->cycles_parent);
+        print_freq("child", &freq_child, results->cycles_child);
+        if (freq.user_only || freq_child.user_only)
+        {
+            INFO("Cycles counted in user space only, the effective frequency is derived from the ratio\n");
+        }
+        INFO("Effective frequency variation: %.2f%%\n", 100.0 * results->freq_variation);
+        if (!results->freq_stable)
+        {
+            WARNING("Effective frequency varied by %.2f%%, beyond the tolerance of %.2f%%\n",
+                    100.0 * results->freq_variation, 100.0 * settings->freq_tolerance);
+        }
+    }
+
+    // Every task accesses its whole working set iterations_per_yield times per slice. In a sequential run the child
+    // does nothing during the middle phase, so its middle phase rates are left at zero.
+    results->accesses = cache_line_count * settings->access_per_cache_line * settings->iterations_per_yield * settings->yield_count;
+    results->bytes = cache_line_count * settings->cache_line_size * settings->iterations_per_yield * settings->yield_count;
+    compute_rates(results->accesses, results->bytes, ns_to_timespec(time_work_ns), &results->rates_parent);
+    compute_rates(results->accesses, results->bytes, ns_to_timespec(time_work_child_ns), &results->rates_child);
+    compute_rates(results->accesses, results->bytes, ns_to_timespec(time_work_middle_ns),
+            &results->rates_middle_parent);
+    compute_rates(settings->concurrent_run ? results->accesses : 0, results->bytes,
+            ns_to_timespec(time_work_middle_child_ns), &results->rates_middle_child);
+
+    human_readable_size(results->bytes, buf, sizeof(buf));
+    INFO("Memory accesses per task: %zu\n", results->accesses);
+    INFO("Bytes touched per task: %s\n", buf);
+    print_rates("middle parent", &results->rates_middle_parent);
+    print_rates("middle child", &results->rates_middle_child);
+    print_rates("parent", &results->rates_parent);
+    print_rates("child", &results->rates_child);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        close(parent_pipefds[i]);
+        close(child_pipefds[i]);
+    }
+
+    return 0;
+}
+
+// Starts the helpers, runs the measured tasks and stops the helpers again, also when the measurement fails.
+int run_measurement(const struct settings *settings, struct results *results)
+{
+    struct helpers helpers;
+    memset(&helpers, 0, sizeof(helpers));
+    helpers.owner = getpid();
+
+    // The antagonists are started before the measured tasks allocate their memory, so that they are up to speed
+    // when the timed region begins. They report their progress through a shared mapping.
+    int antagonist_count = CPU_COUNT(&settings->antagonist_cpus);
+    if (antagonist_count > 0)
+    {
+        helpers.antagonist_passes = mmap(NULL, antagonist_count * sizeof(size_t), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (helpers.antagonist_passes == MAP_FAILED)
+        {
+            perror("mmap");
+            return -1;
+        }
+        fflush(stdout);
+        helpers.antagonist_count = start_antagonists(settings, helpers.antagonist_pids, helpers.antagonist_passes);
+    }
+
+    helpers.reporter_pid = -1;
+    if (settings->progress_interval > 0)
+    {
+        helpers.telemetry = mmap(NULL, sizeof(struct telemetry), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                -1, 0);
+        if (helpers.telemetry == MAP_FAILED)
+        {
+            perror("mmap");
+            helpers.telemetry = NULL;
+        }
+        else
+        {
+            fflush(stdout);
+            helpers.reporter_pid = start_reporter(settings, helpers.telemetry);
+        }
+    }
+
+    int ret = -1;
+    if (helpers.antagonist_count != antagonist_count)
+    {
+        ERROR("Only %d of %d antagonists started\n", helpers.antagonist_count, antagonist_count);
+    }
+    else if ((settings->progress_interval > 0) && (helpers.reporter_pid == -1))
+    {
+        ERROR("Progress reporter not started\n");
+    }
+    else if (clock_gettime(CLOCK_MONOTONIC, &helpers.time_antagonists_start))
+    {
+        perror("clock_gettime");
+    }
+    else
+    {
+        ret = run_tasks(settings, &helpers, results);
+    }
+
+    // the measured child only returns when it failed, the helpers are left to the parent
+    if (getpid() != helpers.owner)
+    {
+        return ret;
+    }
+
+    // antagonists that were already stopped after the timed region are only reaped
+    stop_antagonists(helpers.antagonist_pids, helpers.antagonist_count);
+    if (reap_antagonists(helpers.antagonist_pids, helpers.antagonist_count))
+    {
+        ret = -1;
+    }
+    if (helpers.antagonist_passes)
+    {
+        munmap((void *) helpers.antagonist_passes, antagonist_count * sizeof(size_t));
+    }
+
+    // the reporter stops by itself once the measurement has finished, otherwise it is killed
+    if (helpers.reporter_pid > 0)
+    {
+        if (ret)
+        {
+            kill(helpers.reporter_pid, SIGKILL);
+        }
+        if (waitpid(helpers.reporter_pid, NULL, 0) == -1)
+        {
+            perror("waitpid");
+            ret = -1;
+        }
+    }
+    if (helpers.telemetry)
+    {
+        munmap(helpers.telemetry, sizeof(struct telemetry));
+    }
+
+    return ret;
+}
+
+// Two-sided 95% quantiles of Student's t-distribution for 1 to 30 degrees of freedom.
+const double t_quantiles[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+double t_quantile(size_t degrees_of_freedom)
+{
+    if (degrees_of_freedom == 0)
+    {
+        return INFINITY;
+    }
+    if (degrees_of_freedom <= sizeof(t_quantiles) / sizeof(t_quantiles[0]))
+    {
+        return t_quantiles[degrees_of_freedom-1];
+    }
+    return 1.960;
+}
+
+// Repeats pairs of sequential and concurrent runs until the confidence interval of the concurrency penalty is
+// narrow enough or the time budget is spent. The results of the last concurrent run are returned.
+int run_until_stable(const struct settings *settings, struct results *results)
+{
+    struct settings trial_settings = *settings;
+    struct results sequential;
+    struct stability stability;
+    memset(&stability, 0, sizeof(stability));
+
+    double penalties[STABILITY_MAX_TRIALS];
+    double time_concurrent_sum = 0.0;
+    double time_sequential_sum = 0.0;
+
+    struct timespec time_start;
+    clock_gettime(CLOCK_MONOTONIC, &time_start);
+
+    // the details of every run are only printed for debug verbosity
+    int saved_verbose = verbose;
+    int trial_verbose = verbose == 2 ? 1 : verbose;
+    verbose = trial_verbose;
+
+    while (stability.trials < STABILITY_MAX_TRIALS)
+    {
+        // alternate the order to cancel out slow drift
+        for (int i = 0; i < 2; ++i)
+        {
+            trial_settings.concurrent_run = (i + stability.trials + stability.discarded) % 2;
+            if (run_measurement(&trial_settings, trial_settings.concurrent_run ? results : &sequential))
+            {
+                verbose = saved_verbose;
+                return -1;
+            }
+        }
+
+        struct timespec time_now;
+        if (!results->freq_stable || !sequential.freq_stable)
+        {
+            ++stability.discarded;
+            verbose = saved_verbose;
+            INFO("Trial discarded, effective frequency varied by %.2f%%\n",
+                    100.0 * fmax(results->freq_variation, sequential.freq_variation));
+            verbose = trial_verbose;
+
+            clock_gettime(CLOCK_MONOTONIC, &time_now);
+            stability.elapsed = (timespec_to_ns(time_now) - timespec_to_ns(time_start)) / 1e9;
+            if (stability.elapsed >= settings->time_budget)
+            {
+                break;
+            }
+            continue;
+        }
+
+        double time_concurrent = timespec_to_ns(results->time) / 1e9;
+        double time_sequential = timespec_to_ns(sequential.time) / 1e9;
+        penalties[stability.trials++] = time_concurrent - time_sequential;
+        time_concurrent_sum += time_concurrent;
+        time_sequential_sum += time_sequential;
+
+        size_t n = stability.trials;
+        double mean = 0.0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            mean += penalties[i];
+        }
+        mean /= n;
+        double variance = 0.0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            variance += (penalties[i] - mean) * (penalties[i] - mean);
+        }
+        variance = n > 1 ? variance / (n - 1) : 0.0;
+
+        stability.penalty = mean;
+        stability.penalty_ci = t_quantile(n - 1) * sqrt(variance / n);
+        stability.relative_error = mean != 0.0 ? stability.penalty_ci / fabs(mean) : INFINITY;
+        stability.time_concurrent = time_concurrent_sum / n;
+        stability.time_sequential = time_sequential_sum / n;
+
+        clock_gettime(CLOCK_MONOTONIC, &time_now);
+        stability.elapsed = (timespec_to_ns(time_now) - timespec_to_ns(time_start)) / 1e9;
+
+        verbose = saved_verbose;
+        INFO("Trial %zu: penalty %.9f s, mean %.9f s +- %.9f s, relative error %.4f\n", n, penalties[n-1], mean,
+                stability.penalty_ci, stability.relative_error);
+        verbose = trial_verbose;
+
+        if ((n >= STABILITY_MIN_TRIALS) && (stability.relative_error <= settings->until_stable))
+        {
+            stability.converged = true;
+            break;
+        }
+        if (stability.elapsed >= settings->time_budget)
+        {
+            break;
+        }
+    }
+    verbose = saved_verbose;
+
+    if (!stability.converged)
     {
-        perror("clock_gettime");
-        exit(EXIT_FAILURE);
+        WARNING("Concurrency penalty did not converge to %.4f relative error in %zu trials\n", settings->until_stable,
+                stability.trials);
+    }
+    INFO("Trials needed: %zu\n", stability.trials);
+    if (stability.discarded)
+    {
+        INFO("Trials discarded: %zu\n", stability.discarded);
+    }
+    INFO("Concurrency penalty: %.9f s +- %.9f s (relative error %.4f)\n", stability.penalty, stability.penalty_ci,
+            stability.relative_error);
+    INFO("Mean execution time concurrent: %.9f s\n", stability.time_concurrent);
+    INFO("Mean execution time sequential: %.9f s\n", stability.time_sequential);
+
+    results->stability = stability;
+    return 0;
+}
+
+// One line of JSON with the results of a campaign point.
+void write_campaign_line(int fd, int cpu, const struct settings *settings, const struct results *results)
+{
+    dprintf(fd, "{ \"cpu\": %d, \"memory\": %zu, \"reuse\": %zu, \"backing\": \"%s\", \"concurrent\": %s, ", cpu,
+            settings->memory_total, settings->reuse, backing_to_str(settings->backing),
+            settings->concurrent_run ? "true" : "false");
+    if (settings->audit_mode != AUDIT_OFF)
+    {
+        dprintf(fd, "\"audit_score\": %d, ", settings->campaign_audit_scores[cpu]);
+    }
+    dprintf(fd, "\"cpu_freq_start\": %zd, \"cpu_freq_finish\": %zd, ", settings->cpu_freq_start,
+            settings->cpu_freq_finish);
+    dprintf(fd, "\"time\": %ld.%09ld, ", results->time.tv_sec, results->time.tv_nsec);
+    dprintf(fd, "\"time_parent\": %ld.%09ld, ", results->time_parent.tv_sec, results->time_parent.tv_nsec);
+    dprintf(fd, "\"time_child\": %ld.%09ld, ", results->time_child.tv_sec, results->time_child.tv_nsec);
+    dprintf(fd, "\"time_middle_parent\": %ld.%09ld, ", results->time_middle_parent.tv_sec,
+            results->time_middle_parent.tv_nsec);
+    dprintf(fd, "\"time_middle_child\": %ld.%09ld, ", results->time_middle_child.tv_sec,
+            results->time_middle_child.tv_nsec);
+    dprintf(fd, "\"ivcsw_parent\": %zu, \"ivcsw_child\": %zu, ", results->ivcsw_parent, results->ivcsw_child);
+    dprintf(fd, "\"minflt_timed_parent\": %zu, \"minflt_timed_child\": %zu, ", results->minflt_timed_parent,
+            results->minflt_timed_child);
+    dprintf(fd, "\"majflt_timed_parent\": %zu, \"majflt_timed_child\": %zu, ", results->majflt_timed_parent,
+            results->majflt_timed_child);
+    dprintf(fd, "\"minflt_prefault_parent\": %zu, \"minflt_prefault_child\": %zu, ", results->prefault_parent.minflt,
+            results->prefault_child.minflt);
+    dprintf(fd, "\"ghz_parent\": %.6f, \"ghz_child\": %.6f, ", results->freq_parent.total.ghz,
+            results->freq_child.total.ghz);
+    dprintf(fd, "\"ns_per_access_parent\": %.6f, \"ns_per_access_child\": %.6f }\n",
+            results->rates_parent.ns_per_access, results->rates_child.ns_per_access);
+}
+
+// Every memory size is measured with every reuse percentage.
+void campaign_point_settings(const struct settings *settings, size_t point, struct settings *point_settings)
+{
+    *point_settings = *settings;
+    if (settings->campaign_reuse_count)
+    {
+        point_settings->memory_total = settings->campaign_memory[point / settings->campaign_reuse_count];
+        point_settings->reuse = settings->campaign_reuse[point % settings->campaign_reuse_count];
+    }
+    else
+    {
+        point_settings->memory_total = settings->campaign_memory[point];
+    }
+}
+
+// Runs every point of the campaign as an independent measurement. Each point is run by a worker process pinned to a
+// free campaign CPU. When a worker exits, its results are streamed out and its CPU takes the next point.
+int run_campaign(const struct settings *settings)
+{
+    int fd = STDOUT_FILENO;
+    if (strlen(settings->outfile) > 0)
+    {
+        fd = open_outfile(settings);
+        if (fd == -1)
+        {
+            return -1;
+        }
+    }
+
+    int cpus[CPU_SETSIZE];
+    size_t cpu_count = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &settings->campaign_cpus))
+        {
+            cpus[cpu_count++] = cpu;
+        }
     }
-    long time_diff_middle_ns = time_middle.tv_nsec - time_start.tv_nsec +
-                        (time_middle.tv_sec - time_start.tv_sec) * 1000 * 1000 * 1000;
-    struct timespec time_diff_middle = {
-            .tv_sec = time_diff_middle_ns / (1000 * 1000 * 1000),
-            .tv_nsec = time_diff_middle_ns % (1000 * 1000 * 1000)
-    };
 
-    if (is_child && !settings.concurrent_run)
+    pid_t pids[CPU_SETSIZE];    // 0 when the CPU is free
+    int pipefds[CPU_SETSIZE][2];
+    size_t points[CPU_SETSIZE];
+    ssize_t cpu_freq_start[CPU_SETSIZE];
+    memset(pids, 0, sizeof(pids));
+
+    // the details of every point are only printed for debug verbosity
+    int saved_verbose = verbose;
+    verbose = verbose == 2 ? 1 : verbose;
+
+    size_t point_count = campaign_point_count(settings);
+    size_t next = 0;
+    size_t running = 0;
+    size_t failed = 0;
+    while ((next < point_count) || (running > 0))
     {
-        for (size_t i = 0; i < settings.yield_count; ++i)
+        for (size_t i = 0; (i < cpu_count) && (next < point_count); ++i)
         {
-            for (size_t j = 0; j < settings.iterations_per_yield; ++j)
+            if (pids[i])
+            {
+                continue;
+            }
+            if (pipe2(pipefds[i], O_CLOEXEC))
+            {
+                perror("pipe2");
+                verbose = saved_verbose;
+                return -1;
+            }
+
+            // the cpufreq of every campaign CPU is read around each of its points, if the CPU given with --cpu has it
+            cpu_freq_start[i] = 0;
+            if (settings->cpu_freq_start)
+            {
+                struct settings cpu_settings = *settings;
+                cpu_settings.cpu = cpus[i];
+                cpu_freq_start[i] = get_cpu_freq_cpuinfo(&cpu_settings);
+            }
+
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid == -1)
+            {
+                perror("fork");
+                verbose = saved_verbose;
+                return -1;
+            }
+            if (pid == 0)
             {
-                for (size_t n = 0; n < cache_line_count; ++n)
+                close(pipefds[i][0]);
+                struct settings point_settings;
+                campaign_point_settings(settings, next, &point_settings);
+                point_settings.cpu = cpus[i];
+
+                // workers that run at the same time must not map the same range of the backing file
+                if ((point_settings.backing == BACKING_FILE) && (cpu_count > 1) &&
+                        (snprintf(point_settings.backing_path, sizeof(point_settings.backing_path), "%s.cpu%d",
+                                settings->backing_path, cpus[i]) >= (int) sizeof(point_settings.backing_path)))
                 {
-                    for (size_t m = 0; m < settings.access_per_cache_line; ++m)
-                    {
-                        memory_blocks[n][m&(settings.cache_line_size/sizeof(size_t)-1)]++;
-                    }
+                    ERROR("Backing file path for CPU %d is longer than %zu characters\n", cpus[i],
+                            sizeof(point_settings.backing_path) - 1);
+                    exit(EXIT_FAILURE);
+                }
+
+                struct results results;
+                memset(&results, 0, sizeof(results));
+                if (set_affinity(point_settings.cpu) || run_measurement(&point_settings, &results))
+                {
+                    exit(EXIT_FAILURE);
                 }
+                if (write(pipefds[i][1], &results, sizeof(results)) != sizeof(results))
+                {
+                    perror("write");
+                    exit(EXIT_FAILURE);
+                }
+                exit(EXIT_SUCCESS);
+            }
+
+            close(pipefds[i][1]);
+            pids[i] = pid;
+            points[i] = next++;
+            ++running;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        if (pid == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
             }
+            perror("wait");
+            verbose = saved_verbose;
+            return -1;
+        }
+        size_t i = 0;
+        while ((i < cpu_count) && (pids[i] != pid))
+        {
+            ++i;
+        }
+        if (i == cpu_count)
+        {
+            continue;
+        }
+
+        struct settings point_settings;
+        campaign_point_settings(settings, points[i], &point_settings);
+        point_settings.cpu = cpus[i];
+        point_settings.cpu_freq_start = cpu_freq_start[i];
+        point_settings.cpu_freq_finish = cpu_freq_start[i] ? get_cpu_freq_cpuinfo(&point_settings) : 0;
+        struct results results;
+        if (WIFEXITED(status) && (WEXITSTATUS(status) == 0) &&
+                (read(pipefds[i][0], &results, sizeof(results)) == sizeof(results)))
+        {
+            write_campaign_line(fd, cpus[i], &point_settings, &results);
+        }
+        else
+        {
+            ERROR("Campaign point %zu on CPU %d failed\n", points[i], cpus[i]);
+            ++failed;
         }
+        close(pipefds[i][0]);
+        pids[i] = 0;
+        --running;
     }
+    verbose = saved_verbose;
 
-    struct timespec time_finished;
-    if (clock_gettime(CLOCK_MONOTONIC, &time_finished))
+    if (fd != STDOUT_FILENO)
     {
-        perror("clock_gettime");
-        exit(EXIT_FAILURE);
+        close(fd);
     }
 
-    for (size_t i = 0; i < cache_line_count; ++i)
+    INFO("Campaign points measured: %zu of %zu\n", point_count - failed, point_count);
+    return failed ? -1 : 0;
+}
+
+// Both tasks start the timed region together and share one CPU, so each execution time also covers the slices of the
+// other task. The longer one spans the whole timed region, which holds the yield_count slices of both tasks.
+double time_per_slice(const struct settings *settings, const struct results *results)
+{
+    long time_ns = timespec_to_ns(results->time_parent);
+    if (timespec_to_ns(results->time_child) > time_ns)
     {
-        free(memory_blocks[i]);
+        time_ns = timespec_to_ns(results->time_child);
     }
-    free(memory_blocks);
+    return time_ns / 1e9 / (2 * settings->yield_count);
+}
 
-    long time_diff_ns = time_finished.tv_nsec - time_start.tv_nsec +
-                        (time_finished.tv_sec - time_start.tv_sec) * 1000 * 1000 * 1000;
-    struct timespec time_diff = {
-            .tv_sec = time_diff_ns / (1000 * 1000 * 1000),
-            .tv_nsec = time_diff_ns % (1000 * 1000 * 1000)
-    };
+// Fits a line to the time per slice against the iterations per slice by least squares. The results of the last run
+// are returned.
+int run_refill_fit(const struct settings *settings, struct results *results)
+{
+    struct settings trial_settings = *settings;
+    struct refill_fit fit;
+    memset(&fit, 0, sizeof(fit));
 
-    if (is_child)
+    // the details of every run are only printed for debug verbosity
+    int saved_verbose = verbose;
+    int trial_verbose = verbose == 2 ? 1 : verbose;
+    verbose = trial_verbose;
+
+    trial_settings.iterations_per_yield = 0;
+    if (run_measurement(&trial_settings, results))
     {
-        if (write(child_pipefds[1], &rusage_self, sizeof(rusage_self)) == -1)
+        verbose = saved_verbose;
+        return -1;
+    }
+    fit.switch_cost = time_per_slice(settings, results);
+
+    for (size_t i = 0; i < settings->fit_points; ++i)
+    {
+        trial_settings.iterations_per_yield = settings->fit_iterations[i];
+        if (run_measurement(&trial_settings, results))
         {
-            perror("write");
-            exit(EXIT_FAILURE);
+            verbose = saved_verbose;
+            return -1;
         }
-        if (write(child_pipefds[1], &time_diff_middle, sizeof(time_diff_middle)) == -1)
+        fit.iterations[i] = settings->fit_iterations[i];
+        fit.time_per_slice[i] = time_per_slice(settings, results);
+        fit.points++;
+
+        verbose = saved_verbose;
+        INFO("Fit point %zu: %zu iterations, %.9f s per slice\n", fit.points, fit.iterations[i],
+                fit.time_per_slice[i]);
+        verbose = trial_verbose;
+    }
+    verbose = saved_verbose;
+
+    size_t n = fit.points;
+    double x_mean = 0.0;
+    double y_mean = 0.0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        x_mean += fit.iterations[i];
+        y_mean += fit.time_per_slice[i];
+    }
+    x_mean /= n;
+    y_mean /= n;
+
+    double sxx = 0.0;
+    double sxy = 0.0;
+    double syy = 0.0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        double dx = fit.iterations[i] - x_mean;
+        double dy = fit.time_per_slice[i] - y_mean;
+        sxx += dx * dx;
+        sxy += dx * dy;
+        syy += dy * dy;
+    }
+    fit.pass_cost = sxy / sxx;
+    fit.intercept = y_mean - fit.pass_cost * x_mean;
+    fit.refill_cost = fit.intercept - fit.switch_cost;
+
+    double ss_residual = 0.0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        double residual = fit.time_per_slice[i] - (fit.intercept + fit.pass_cost * fit.iterations[i]);
+        ss_residual += residual * residual;
+    }
+    fit.r_squared = syy > 0.0 ? 1.0 - ss_residual / syy : 1.0;
+
+    INFO("Switch cost per slice: %.9f s\n", fit.switch_cost);
+    INFO("Refill cost per switch: %.9f s\n", fit.refill_cost);
+    INFO("Pass cost: %.9f s\n", fit.pass_cost);
+    INFO("Fit R^2: %.6f\n", fit.r_squared);
+    if (fit.refill_cost < 0.0)
+    {
+        WARNING("Negative refill cost, the working sets of both tasks may fit in the caches or the fit is noisy\n");
+    }
+
+    results->fit = fit;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    char buf[128];
+
+    struct settings settings;
+    initialize_settings(&settings);
+
+    if (parse_options(&settings, argc, argv))
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    // without an output file the campaign lines go to stdout, keep the messages of all processes out of them
+    if ((CPU_COUNT(&settings.campaign_cpus) > 0) && (strlen(settings.outfile) == 0))
+    {
+        messages_to_stderr = true;
+    }
+
+    if (configure(&settings))
+    {
+        show_help(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    print_settings(&settings);
+
+    if (settings.coroutine_count)
+    {
+        struct coroutine_results coroutine_results;
+        if (run_coroutines(&settings, &coroutine_results))
         {
-            perror("write");
             exit(EXIT_FAILURE);
         }
-        if (write(child_pipefds[1], &time_diff, sizeof(time_diff)) == -1)
+        print_coroutine_results(&coroutine_results);
+        if ((strlen(settings.outfile) > 0) && write_file_coroutines(&settings, &coroutine_results))
         {
-            perror("write");
             exit(EXIT_FAILURE);
         }
         exit(EXIT_SUCCESS);
     }
 
-    struct rusage rusage_child_start;
-    struct timespec time_diff_middle_child;
-    struct timespec time_diff_child;
-    if (read(child_pipefds[0], &rusage_child_start, sizeof(rusage_child_start)) == -1)
+    if (CPU_COUNT(&settings.campaign_cpus) > 0)
     {
-        perror("read");
-        exit(EXIT_FAILURE);
+        exit(run_campaign(&settings) ? EXIT_FAILURE : EXIT_SUCCESS);
     }
-    if (read(child_pipefds[0], &time_diff_middle_child, sizeof(time_diff_middle_child)) == -1)
+
+    struct results results;
+    memset(&results, 0, sizeof(results));
+    if (settings.until_stable > 0.0)
     {
-        perror("read");
-        exit(EXIT_FAILURE);
+        if (run_until_stable(&settings, &results))
+        {
+            exit(EXIT_FAILURE);
+        }
     }
-    if (read(child_pipefds[0], &time_diff_child, sizeof(time_diff_child)) == -1)
+    else if (settings.fit_points)
+    {
+        if (run_refill_fit(&settings, &results))
+        {
+            exit(EXIT_FAILURE);
+        }
+    }
+    else if (run_measurement(&settings, &results))
     {
-        perror("read");
         exit(EXIT_FAILURE);
     }
 
-    INFO("Execution time middle parent: %ld.%09ld s\n", time_diff_middle.tv_sec, time_diff_middle.tv_nsec);
-    INFO("Execution time middle child: %ld.%09ld s\n", time_diff_middle_child.tv_sec, time_diff_middle_child.tv_nsec);
-    INFO("Execution time parent: %ld.%09ld s\n", time_diff.tv_sec, time_diff.tv_nsec);
-    INFO("Execution time child: %ld.%09ld s\n", time_diff_child.tv_sec, time_diff_child.tv_nsec);
-
-    long time_diff_average_ns = ((time_diff.tv_sec + time_diff_child.tv_sec) * 1000 * 1000 * 1000 +
-                                time_diff.tv_nsec + time_diff_child.tv_nsec) / 2;
-    struct timespec time_diff_average = {
-            .tv_sec = time_diff_average_ns / (1000 * 1000 * 1000),
-            .tv_nsec = time_diff_average_ns % (1000 * 1000 * 1000)
-    };
-
-    INFO("Execution time average: %ld.%09ld s\n", time_diff_average.tv_sec, time_diff_average.tv_nsec);
-
     if (settings.cpu_freq_start)
     {
         settings.cpu_freq_finish = get_cpu_freq_cpuinfo(&settings);
@@ -972,53 +5521,6 @@ int main(int argc, char *argv[])
         }
     }
 
-    if (!is_child)
-    {
-        wait(NULL);
-    }
-
-    struct rusage rusage_parent;
-    if (getrusage(RUSAGE_SELF, &rusage_parent))
-    {
-        perror("getrusage");
-        exit(EXIT_FAILURE);
-    }
-    struct rusage rusage_child;
-    if (getrusage(RUSAGE_CHILDREN, &rusage_child))
-    {
-        perror("getrusage");
-        exit(EXIT_FAILURE);
-    }
-
-    INFO("Parent minor page faults diff: %zu\n", rusage_parent.ru_minflt - rusage_self.ru_minflt);
-    INFO("Parent major page faults diff: %zu\n", rusage_parent.ru_majflt - rusage_self.ru_majflt);
-    INFO("Child minor page faults diff: %zu\n", rusage_child.ru_minflt - rusage_child_start.ru_minflt);
-    INFO("Child major page faults diff: %zu\n", rusage_child.ru_majflt - rusage_child_start.ru_majflt);
-
-    INFO("Parent voluntary context switches: %zu\n", rusage_parent.ru_nvcsw);
-    INFO("Parent involuntary context switches: %zu\n", rusage_parent.ru_nivcsw);
-    INFO("Child voluntary context switches: %zu\n", rusage_child.ru_nvcsw);
-    INFO("Child involuntary context switches: %zu\n", rusage_child.ru_nivcsw);
-
-    struct results results = {
-        .time = time_diff_average,
-        .time_parent = time_diff,
-        .time_child = time_diff_child,
-        .time_middle_parent = time_diff_middle,
-        .time_middle_child = time_diff_middle_child,
-        .vcsw_parent = rusage_parent.ru_nvcsw,
-        .ivcsw_parent = rusage_parent.ru_nivcsw,
-        .vcsw_child = rusage_child.ru_nvcsw,
-        .ivcsw_child = rusage_child.ru_nivcsw,
-        .minflt_parent_start = rusage_self.ru_minflt,
-        .minflt_parent_end = rusage_parent.ru_minflt,
-        .majflt_parent_start = rusage_self.ru_majflt,
-        .majflt_parent_end = rusage_parent.ru_majflt,
-        .minflt_child_start = rusage_child_start.ru_minflt,
-        .minflt_child_end = rusage_child.ru_minflt,
-        .majflt_child_start = rusage_child_start.ru_majflt,
-        .majflt_child_end = rusage_child.ru_majflt,
-    };
     if (strlen(settings.outfile) > 0)
     {
         if (write_file(&settings, &results))
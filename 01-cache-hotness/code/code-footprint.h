@@ -0,0 +1,15 @@
+#ifndef CODE_FOOTPRINT_H
+#define CODE_FOOTPRINT_H
+
+#include <stddef.h>
+
+// The functions of the code workload, generated at build time by gen-code-footprint.sh. Every function takes the
+// result of the previous one, so a pass over the table executes every function in order.
+extern unsigned long (*const code_footprint_functions[])(unsigned long);
+extern const size_t code_footprint_function_count;
+
+// Provided by the linker, the bounds of the section holding all the generated functions.
+extern const char __start_code_footprint[];
+extern const char __stop_code_footprint[];
+
+#endif
@@ -0,0 +1,47 @@
+#!/bin/sh
+# Generates the functions of the code workload: COUNT distinct functions of roughly equal size, all placed in the
+# code_footprint section so that the linker provides its bounds, and a table to call them in sequence.
+#
+# Usage: gen-code-footprint.sh COUNT > code-footprint.c
+
+count=${1:-4096}
+
+awk -v count="$count" 'BEGIN {
+    statements = 24
+    seed = 1
+
+    print "// Generated by gen-code-footprint.sh, do not edit."
+    print ""
+    print "#include \"code-footprint.h\""
+    print ""
+
+    for (f = 0; f < count; ++f)
+    {
+        # optimizing megabytes of straight-line code takes minutes and changes nothing about its footprint
+        print "__attribute__((optimize(\"O0\"), noinline, used, aligned(64), section(\"code_footprint\")))"
+        printf "static unsigned long code_function_%d(unsigned long x)\n", f
+        print "{"
+        # distinct constants in every function keep the linker and compiler from folding them together
+        for (s = 0; s < statements; ++s)
+        {
+            seed = (seed * 1103515245 + 12345) % 2147483648
+            multiplier = seed
+            seed = (seed * 1103515245 + 12345) % 2147483648
+            addend = seed
+            printf "    x = x * 0x%08x%08xUL + 0x%08x%08xUL;\n", multiplier, (f * statements + s) * 2 + 1, addend, f
+            printf "    x ^= x >> %d;\n", 17 + (s + f) % 29
+        }
+        print "    return x;"
+        print "}"
+        print ""
+    }
+
+    print "unsigned long (*const code_footprint_functions[])(unsigned long) = {"
+    for (f = 0; f < count; ++f)
+    {
+        printf "    code_function_%d,\n", f
+    }
+    print "};"
+    print ""
+    printf "const size_t code_footprint_function_count = %d;\n", count
+}'